@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "./Arena.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+Arena Arena_make(size_t chunkSize) {
+  assert(chunkSize > 0);
+  Arena arena = {
+    .first = NULL,
+    .current = NULL,
+    .last = NULL,
+    .chunkSize = chunkSize,
+    .numMallocs = 0
+  };
+  return arena;
+}
+
+void Arena_destroy(Arena* arena) {
+  ArenaChunk* chunk = arena->first;
+  while (chunk != NULL) {
+    ArenaChunk* next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  arena->first = arena->current = arena->last = NULL;
+}
+
+// Offset of the first byte in chunk at or after its used bytes that is
+// aligned to ARENA_ALIGNMENT
+static inline size_t aligned_offset(const ArenaChunk* chunk) {
+  uintptr_t start = (uintptr_t) chunk->data;
+  uintptr_t next = (start + chunk->used + ARENA_ALIGNMENT - 1)
+      & ~((uintptr_t) ARENA_ALIGNMENT - 1);
+  return next - start;
+}
+
+void* Arena_alloc(Arena* arena, size_t size) {
+  // Move on through the chunks kept from before the last reset until one
+  // has room, and only then add a new one.
+  while (arena->current != NULL) {
+    ArenaChunk* chunk = arena->current;
+    size_t offset = aligned_offset(chunk);
+    if (offset + size <= chunk->size) {
+      chunk->used = offset + size;
+      return chunk->data + offset;
+    }
+    arena->current = chunk->next;
+    if (arena->current != NULL) {
+      arena->current->used = 0;
+    }
+  }
+
+  size_t chunkSize = arena->chunkSize;
+  if (arena->last != NULL && chunkSize < 2 * arena->last->size) {
+    chunkSize = 2 * arena->last->size;
+  }
+  if (chunkSize < size + ARENA_ALIGNMENT) {
+    chunkSize = size + ARENA_ALIGNMENT;
+  }
+  ArenaChunk* chunk = malloc(sizeof(ArenaChunk) + chunkSize);
+  assert(chunk != NULL);
+  arena->numMallocs++;
+  chunk->next = NULL;
+  chunk->size = chunkSize;
+  chunk->used = 0;
+  if (arena->last == NULL) {
+    arena->first = chunk;
+  } else {
+    arena->last->next = chunk;
+  }
+  arena->last = chunk;
+  arena->current = chunk;
+
+  size_t offset = aligned_offset(chunk);
+  chunk->used = offset + size;
+  return chunk->data + offset;
+}
+
+void Arena_reset(Arena* arena) {
+  // Later chunks have their used counts cleared as Arena_alloc() reaches
+  // them.
+  arena->current = arena->first;
+  if (arena->current != NULL) {
+    arena->current->used = 0;
+  }
+}
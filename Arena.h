@@ -0,0 +1,73 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Bump allocator: memory is carved off the end of large chunks and only ever
+// released all at once.  Chunks are kept across resets, so once an arena has
+// grown to its high-water mark, allocating from it needs no malloc.
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <stddef.h>
+
+// Alignment of every allocation, one cache line
+#define ARENA_ALIGNMENT 64
+// Size of an arena's first chunk; each later chunk is at least twice the
+// size of the one before it
+#define ARENA_DEFAULT_CHUNK_SIZE (1 << 20)
+
+typedef struct ArenaChunk ArenaChunk;
+
+struct ArenaChunk {
+  ArenaChunk* next;
+  size_t size;
+  size_t used;
+  char data[];
+};
+
+struct Arena {
+  // chunks in the order they are filled
+  ArenaChunk* first;
+  ArenaChunk* current;
+  ArenaChunk* last;
+  size_t chunkSize;
+
+  // calls to malloc made by the arena since it was made
+  unsigned long numMallocs;
+};
+typedef struct Arena Arena;
+
+// Returns an empty arena.  No memory is allocated until the first
+// Arena_alloc().
+Arena Arena_make(size_t chunkSize);
+
+// Frees every chunk.
+void Arena_destroy(Arena* arena);
+
+// Returns size bytes aligned to ARENA_ALIGNMENT, valid until the next
+// Arena_reset().
+void* Arena_alloc(Arena* arena, size_t size);
+
+// Releases everything allocated from the arena, in constant time.  The
+// chunks are kept for reuse.
+void Arena_reset(Arena* arena);
+
+#endif  // ARENA_H_
@@ -0,0 +1,282 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "./BroadPhase.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "./CollisionStats.h"
+#include "./PhaseTimer.h"
+
+static const char* typeNames[] = {
+  [BROADPHASE_QUADTREE] = "quadtree",
+  [BROADPHASE_GRID] = "grid",
+  [BROADPHASE_SAP] = "sap"
+};
+
+BroadPhase BroadPhase_make(BroadPhaseType type, Arena* quadtreeArena,
+                           Arena* staticArena) {
+  BroadPhase broadPhase = {
+    .type = type,
+    .quadtreeParams = QuadtreeParams_default(),
+    .quadtreeArena = quadtreeArena,
+    .staticArena = staticArena,
+    .built = false,
+    .staticEvents = NULL,
+    .numStaticEvents = 0,
+    .pairsTested = 0,
+    .numFrames = 0,
+    .numMallocs = 0
+  };
+  return broadPhase;
+}
+
+void BroadPhase_destroy(BroadPhase* broadPhase) {
+  if (!broadPhase->built) {
+    return;
+  }
+  switch (broadPhase->type) {
+    case BROADPHASE_QUADTREE:
+      destroy_LineQuadtree(&broadPhase->quadtree);
+      destroy_LineQuadtree(&broadPhase->staticTree);
+      break;
+    case BROADPHASE_GRID:
+      broadPhase->numMallocs += broadPhase->grid.numMallocs;
+      UniformGrid_destroy(&broadPhase->grid);
+      break;
+    case BROADPHASE_SAP:
+      broadPhase->numMallocs += broadPhase->sap.numMallocs;
+      SweepAndPrune_destroy(&broadPhase->sap);
+      break;
+  }
+  broadPhase->built = false;
+}
+
+void BroadPhase_setType(BroadPhase* broadPhase, BroadPhaseType type) {
+  BroadPhase_destroy(broadPhase);
+  broadPhase->type = type;
+}
+
+void BroadPhase_setQuadtreeParams(BroadPhase* broadPhase,
+                                  QuadtreeParams params) {
+  assert(params.leafCapacity > 0);
+  BroadPhase_destroy(broadPhase);
+  broadPhase->quadtreeParams = params;
+}
+
+// Split the lines into static ones, which have no velocity, and moving ones,
+// and build a tree of each, unless too few are static to be worth it.  The
+// pairs of static lines are tested here, once.
+static unsigned long build_quadtrees(BroadPhase* broadPhase,
+                                     const LineStore* store,
+                                     Arena* frameArena) {
+  unsigned int n = store->numOfLines;
+  unsigned int* statics = Arena_alloc(frameArena, sizeof(unsigned int) * n);
+  unsigned int* moving = Arena_alloc(frameArena, sizeof(unsigned int) * n);
+  unsigned int numStatic = 0;
+  unsigned int numMoving = 0;
+  for (unsigned int l = 0; l < n; l++) {
+    if (store->velocity[l].x == 0 && store->velocity[l].y == 0) {
+      statics[numStatic++] = l;
+    } else {
+      moving[numMoving++] = l;
+    }
+  }
+  if (numStatic < numMoving / BROADPHASE_STATIC_MIN_RATIO) {
+    numStatic = 0;
+    numMoving = n;
+    moving = NULL;
+  }
+  init_LineQuadtree(&broadPhase->staticTree, store, statics, numStatic,
+                    broadPhase->quadtreeParams, broadPhase->staticArena);
+  init_LineQuadtree(&broadPhase->quadtree, store, moving, numMoving,
+                    broadPhase->quadtreeParams, broadPhase->quadtreeArena);
+
+  // The static lines stay put, so their events stay the same as long as
+  // both lines stay static.
+  LineQuadtree* staticTree = &broadPhase->staticTree;
+  IntersectionEventList staticList = IntersectionEventList_make();
+  unsigned long pairsTested = detect_collisions(
+      &staticList, store, staticTree->quadtrees,
+      &staticTree->numQuadtrees, frameArena);
+  broadPhase->numStaticEvents = IntersectionEventList_size(&staticList);
+  broadPhase->staticEvents = Arena_alloc(
+      broadPhase->staticArena,
+      sizeof(IntersectionEvent) * broadPhase->numStaticEvents);
+  IntersectionEventList_toArray(&staticList, broadPhase->staticEvents);
+  broadPhase->numMallocs += IntersectionEventList_getNumMallocs(&staticList);
+  IntersectionEventList_destroy(&staticList);
+  return pairsTested;
+}
+
+// Append the events between lines that are both still static, dropping the
+// rest for good
+static void repeat_static_events(BroadPhase* broadPhase,
+                                 IntersectionEventList* events) {
+  Quadtree* const* lineNode = broadPhase->staticTree.lineNode;
+  IntersectionEvent* staticEvents = broadPhase->staticEvents;
+  unsigned int numKept = 0;
+  for (unsigned int i = 0; i < broadPhase->numStaticEvents; i++) {
+    IntersectionEvent event = staticEvents[i];
+    if (lineNode[event.l1] != NULL && lineNode[event.l2] != NULL) {
+      staticEvents[numKept++] = event;
+      IntersectionEventList_append(events, event.l1, event.l2,
+                                   (IntersectionType) event.intersectionType);
+    }
+  }
+  broadPhase->numStaticEvents = numKept;
+}
+
+void BroadPhase_detectCollisions(BroadPhase* broadPhase,
+                                 IntersectionEventList* events,
+                                 const LineStore* store, Arena* frameArena) {
+  unsigned long pairsTested = 0;
+  PHASE_START(buildTimer);
+  switch (broadPhase->type) {
+    case BROADPHASE_QUADTREE: {
+      // bring the tree of moving lines up to date with this frame's lines,
+      // building both trees on the first frame
+      LineQuadtree* quadtree = &broadPhase->quadtree;
+      if (!broadPhase->built) {
+        pairsTested = build_quadtrees(broadPhase, store, frameArena);
+      } else {
+        update_LineQuadtree(quadtree, store);
+      }
+      PHASE_STOP(buildTimer, PHASE_BUILD);
+      PHASE_START(pairsTimer);
+      pairsTested += detect_collisions(events, store,
+                                       quadtree->quadtrees,
+                                       &quadtree->numQuadtrees, frameArena);
+      if (broadPhase->staticTree.numMembers > 0) {
+        pairsTested += detect_static_collisions(
+            events, store, &broadPhase->staticTree,
+            quadtree->members, quadtree->numMembers);
+        repeat_static_events(broadPhase, events);
+      }
+      PHASE_STOP(pairsTimer, PHASE_PAIRS);
+#ifdef COLLISION_STATS
+      for (int k = 0; k < quadtree->numQuadtrees; k++) {
+        const Quadtree* node = quadtree->quadtrees[k];
+        CollisionStats_addNode(node->depth, node->numOfLines,
+                               node->depth >= quadtree->params.maxDepth);
+      }
+#endif
+      break;
+    }
+    case BROADPHASE_GRID: {
+      if (!broadPhase->built) {
+        broadPhase->grid = UniformGrid_make(store);
+      }
+      UniformGrid_update(&broadPhase->grid, store);
+      PHASE_STOP(buildTimer, PHASE_BUILD);
+      PHASE_START(pairsTimer);
+      pairsTested = UniformGrid_detectCollisions(&broadPhase->grid, events,
+                                                 store);
+      PHASE_STOP(pairsTimer, PHASE_PAIRS);
+      break;
+    }
+    case BROADPHASE_SAP: {
+      if (!broadPhase->built) {
+        broadPhase->sap = SweepAndPrune_make(store);
+      } else {
+        SweepAndPrune_update(&broadPhase->sap, store);
+      }
+      PHASE_STOP(buildTimer, PHASE_BUILD);
+      PHASE_START(pairsTimer);
+      pairsTested = SweepAndPrune_detectCollisions(&broadPhase->sap, events,
+                                                   store);
+      PHASE_STOP(pairsTimer, PHASE_PAIRS);
+      break;
+    }
+  }
+  broadPhase->built = true;
+  broadPhase->pairsTested += pairsTested;
+  broadPhase->numFrames++;
+}
+
+void BroadPhase_solved(BroadPhase* broadPhase, const LineStore* store,
+                       const IntersectionEvent* events,
+                       unsigned int numEvents) {
+  if (broadPhase->type != BROADPHASE_QUADTREE || !broadPhase->built) {
+    return;
+  }
+  LineQuadtree* staticTree = &broadPhase->staticTree;
+  for (unsigned int i = 0; i < numEvents; i++) {
+    unsigned int pair[2] = { events[i].l1, events[i].l2 };
+    for (int k = 0; k < 2; k++) {
+      unsigned int l = pair[k];
+      Vec velocity = store->velocity[l];
+      if (staticTree->lineNode[l] != NULL
+          && !(velocity.x == 0 && velocity.y == 0)) {
+        remove_line_LineQuadtree(staticTree, l);
+        add_line_LineQuadtree(&broadPhase->quadtree, store, l);
+      }
+    }
+  }
+
+  // Once few static lines are left, testing every moving line against them
+  // costs more than it saves, so they join the moving lines for good, in a
+  // tree rebuilt from all the lines.
+  if (staticTree->numMembers > 0 && staticTree->numMembers
+      < broadPhase->quadtree.numMembers / BROADPHASE_STATIC_MIN_RATIO) {
+    while (staticTree->numMembers > 0) {
+      remove_line_LineQuadtree(
+          staticTree, staticTree->members[staticTree->numMembers - 1]);
+    }
+    broadPhase->numStaticEvents = 0;
+    destroy_LineQuadtree(&broadPhase->quadtree);
+    init_LineQuadtree(&broadPhase->quadtree, store, NULL, 0,
+                      broadPhase->quadtreeParams, broadPhase->quadtreeArena);
+  }
+}
+
+double BroadPhase_getPairsTestedPerFrame(const BroadPhase* broadPhase) {
+  if (broadPhase->numFrames == 0) {
+    return 0;
+  }
+  return (double) broadPhase->pairsTested / broadPhase->numFrames;
+}
+
+unsigned long BroadPhase_getNumMallocs(const BroadPhase* broadPhase) {
+  unsigned long numMallocs = broadPhase->numMallocs;
+  if (broadPhase->built && broadPhase->type == BROADPHASE_GRID) {
+    numMallocs += broadPhase->grid.numMallocs;
+  } else if (broadPhase->built && broadPhase->type == BROADPHASE_SAP) {
+    numMallocs += broadPhase->sap.numMallocs;
+  }
+  return numMallocs;
+}
+
+const char* BroadPhase_typeName(BroadPhaseType type) {
+  return typeNames[type];
+}
+
+bool BroadPhase_parseType(const char* name, BroadPhaseType* type) {
+  for (unsigned int i = 0; i < sizeof(typeNames) / sizeof(typeNames[0]); i++) {
+    if (strcmp(name, typeNames[i]) == 0) {
+      *type = (BroadPhaseType) i;
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,142 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Broad phase: finds the pairs of lines that may intersect and tests them.
+// Every engine tests at least the pairs whose swept bounding boxes overlap,
+// so all engines report the same intersections.
+//
+// The quadtree engine sets the lines with no velocity on its first frame
+// apart in a static tree, which is built once and never updated, since such
+// lines do not move until a collision sets them moving.  Pairs of static
+// lines are tested once and their events repeated each frame, and only the
+// moving lines are kept in the updated tree and tested against the static
+// tree, so a frame's cost follows the number of moving lines.  A static line
+// set moving is moved from the static tree to the updated one, and once the
+// moving lines outnumber the static ones, the rest join them too.  The grid
+// and sweep-and-prune engines make no such split: they still test the pairs
+// of static lines, and update their structures for every line, each frame.
+#ifndef BROADPHASE_H_
+#define BROADPHASE_H_
+
+#include "./Arena.h"
+#include "./Line.h"
+#include "./IntersectionEventList.h"
+#include "./Quadtree.h"
+#include "./SweepAndPrune.h"
+#include "./UniformGrid.h"
+
+// The quadtree engine keeps its static lines apart only while there are
+// fewer than this many times as many moving lines
+#define BROADPHASE_STATIC_MIN_RATIO 1
+
+// The available broad-phase engines.
+typedef enum {
+  BROADPHASE_QUADTREE,
+  BROADPHASE_GRID,
+  BROADPHASE_SAP
+} BroadPhaseType;
+
+struct BroadPhase {
+  BroadPhaseType type;
+
+  // Limits used when the quadtree engine builds its tree.
+  QuadtreeParams quadtreeParams;
+
+  // Arenas the quadtree engine's tree and static tree are allocated from.
+  // Not owned.
+  Arena* quadtreeArena;
+  Arena* staticArena;
+
+  // Whether the engine's structure has been built.  It is built on the first
+  // frame, since that is when all the lines are known.
+  bool built;
+
+  // State of the engine selected by type.
+  LineQuadtree quadtree;
+  UniformGrid grid;
+  SweepAndPrune sap;
+
+  // The quadtree engine's static lines, and the events between them found
+  // when they were set apart.  The events of lines since set moving are
+  // dropped.
+  LineQuadtree staticTree;
+  IntersectionEvent* staticEvents;
+  unsigned int numStaticEvents;
+
+  // Pairs handed to the narrow phase, and frames run, since the broad phase
+  // was made.
+  unsigned long long pairsTested;
+  unsigned int numFrames;
+
+  // Calls to malloc made by the engines outside their arenas, by structures
+  // since discarded.  The built engine's own calls are kept in its state.
+  unsigned long numMallocs;
+};
+typedef struct BroadPhase BroadPhase;
+
+// Returns an unbuilt broad phase using the given engine.  The quadtree
+// engine allocates its tree from quadtreeArena and its static tree from
+// staticArena, and resets them whenever the trees are discarded, so nothing
+// else may allocate from them.
+BroadPhase BroadPhase_make(BroadPhaseType type, Arena* quadtreeArena,
+                           Arena* staticArena);
+
+void BroadPhase_destroy(BroadPhase* broadPhase);
+
+// Selects the engine.  Any built structure is discarded and rebuilt on the
+// next frame.
+void BroadPhase_setType(BroadPhase* broadPhase, BroadPhaseType type);
+
+// Sets the limits on the quadtree engine's tree.  Any built structure is
+// discarded and rebuilt on the next frame.
+void BroadPhase_setQuadtreeParams(BroadPhase* broadPhase,
+                                  QuadtreeParams params);
+
+// Brings the engine up to date with the lines in store and appends an event
+// to events for every intersecting pair.  Memory needed only while finding
+// the pairs comes from frameArena.
+void BroadPhase_detectCollisions(BroadPhase* broadPhase,
+                                 IntersectionEventList* events,
+                                 const LineStore* store, Arena* frameArena);
+
+// Lets the broad phase know that the events, this frame's collisions, have
+// been solved, so that the static lines they set moving are moved to the
+// moving lines.
+void BroadPhase_solved(BroadPhase* broadPhase, const LineStore* store,
+                       const IntersectionEvent* events,
+                       unsigned int numEvents);
+
+// Returns the mean number of pairs tested per frame.
+double BroadPhase_getPairsTestedPerFrame(const BroadPhase* broadPhase);
+
+// Returns the number of calls to malloc made by the engines outside their
+// arenas since the broad phase was made.
+unsigned long BroadPhase_getNumMallocs(const BroadPhase* broadPhase);
+
+// Returns the command-line name of an engine.
+const char* BroadPhase_typeName(BroadPhaseType type);
+
+// Looks up an engine by its command-line name.  Returns false if there is
+// no engine with that name.
+bool BroadPhase_parseType(const char* name, BroadPhaseType* type);
+
+#endif  // BROADPHASE_H_
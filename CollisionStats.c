@@ -0,0 +1,184 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "./CollisionStats.h"
+
+#ifdef COLLISION_STATS
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "./Parallel.h"
+
+// One worker's counters, padded to a cache line so that workers do not
+// share one
+typedef struct {
+  unsigned long counts[STAT_NUM];
+} __attribute__((aligned(64))) StatSlot;
+
+static const char* CollisionStats_names[STAT_NUM] = {
+  [STAT_PAIRS_SAME_NODE] = "pairs within a node",
+  [STAT_PAIRS_ANCESTOR] = "pairs with an ancestor",
+  [STAT_PAIRS_STATIC] = "pairs with static lines",
+  [STAT_TESTS] = "intersection tests",
+  [STAT_BOX_REJECTS] = "swept box rejects",
+  [STAT_DIRECTION_REJECTS] = "first direction rejects",
+  [STAT_HITS + NO_INTERSECTION] = "misses after both tests",
+  [STAT_HITS + L1_WITH_L2] = "L1_WITH_L2 hits",
+  [STAT_HITS + L2_WITH_L1] = "L2_WITH_L1 hits",
+  [STAT_HITS + ALREADY_INTERSECTED] = "ALREADY_INTERSECTED hits",
+};
+
+static StatSlot* CollisionStats_slots = NULL;
+static unsigned int CollisionStats_numSlots = 0;
+static unsigned long CollisionStats_numFrames = 0;
+
+// Lines held at each depth, and leaves at the maximum depth by occupancy,
+// summed over frames
+static unsigned long CollisionStats_depthLines[COLLISIONSTATS_MAX_DEPTH];
+static unsigned long CollisionStats_depthNodes[COLLISIONSTATS_MAX_DEPTH];
+static unsigned long
+    CollisionStats_occupancy[COLLISIONSTATS_OCCUPANCY_BUCKETS];
+
+void CollisionStats_init() {
+  if (CollisionStats_slots != NULL) {
+    return;
+  }
+  CollisionStats_numSlots = Parallel_getNumWorkers();
+  CollisionStats_slots = calloc(CollisionStats_numSlots, sizeof(StatSlot));
+  assert(CollisionStats_slots != NULL);
+}
+
+void CollisionStats_add(Stat stat, unsigned long n) {
+  unsigned int worker = Parallel_getWorkerId();
+  assert(worker < CollisionStats_numSlots);
+  CollisionStats_slots[worker].counts[stat] += n;
+}
+
+void CollisionStats_countTests(const LineStore* lines, unsigned int l,
+                               const unsigned int* candidates,
+                               unsigned int count,
+                               const IntersectionType* types) {
+  unsigned long* counts = CollisionStats_slots[Parallel_getWorkerId()].counts;
+  counts[STAT_TESTS] += count;
+  for (unsigned int k = 0; k < count; k++) {
+    unsigned int l1 = MIN(l, candidates[k]);
+    unsigned int l2 = MAX(l, candidates[k]);
+
+    // Replay the first two tests of intersect().
+    if (!sweptBoxesOverlap(lines, l1, l2)) {
+      counts[STAT_BOX_REJECTS]++;
+      continue;
+    }
+    Vec l1p1 = lines->p1[l1];
+    Vec l1p2 = lines->p2[l1];
+    double dx = (lines->velocity[l2].x - lines->velocity[l1].x) * 0.5;
+    double dy = (lines->velocity[l2].y - lines->velocity[l1].y) * 0.5;
+    Vec p1 = {.x = lines->p1[l2].x + dx, .y = lines->p1[l2].y + dy};
+    Vec p2 = {.x = lines->p2[l2].x + dx, .y = lines->p2[l2].y + dy};
+    double d1 = direction(l1p1, l1p2, lines->p1[l2]);
+    double d2 = direction(l1p1, l1p2, lines->p2[l2]);
+    double d3 = direction(l1p1, l1p2, p1);
+    double d4 = direction(l1p1, l1p2, p2);
+    if ((d1 * d2 > 0) && (d2 * d3 > 0) && (d3 * d4 > 0)) {
+      counts[STAT_DIRECTION_REJECTS]++;
+      continue;
+    }
+    counts[STAT_HITS + types[k]]++;
+  }
+}
+
+void CollisionStats_addNode(unsigned int depth, unsigned int numOfLines,
+                            bool atMaxDepth) {
+  depth = MIN(depth, COLLISIONSTATS_MAX_DEPTH - 1);
+  CollisionStats_depthLines[depth] += numOfLines;
+  CollisionStats_depthNodes[depth]++;
+  if (atMaxDepth) {
+    int bucket = numOfLines == 0 ? 0 : 32 - __builtin_clz(numOfLines);
+    CollisionStats_occupancy[bucket]++;
+  }
+}
+
+void CollisionStats_endFrame() {
+  CollisionStats_numFrames++;
+}
+
+void CollisionStats_print() {
+  double frames = CollisionStats_numFrames;
+  if (frames == 0) {
+    return;
+  }
+
+  unsigned long totals[STAT_NUM] = {0};
+  for (unsigned int w = 0; w < CollisionStats_numSlots; w++) {
+    for (int s = 0; s < STAT_NUM; s++) {
+      totals[s] += CollisionStats_slots[w].counts[s];
+    }
+  }
+
+  printf("---- COLLISION STATS (per frame, %lu frames) ----\n",
+         CollisionStats_numFrames);
+  for (int s = 0; s < STAT_NUM; s++) {
+    printf("%-26s %14.1f", CollisionStats_names[s], totals[s] / frames);
+    if (s > STAT_TESTS && totals[STAT_TESTS] > 0) {
+      printf("  %5.1f%% of tests", 100.0 * totals[s] / totals[STAT_TESTS]);
+    }
+    printf("\n");
+  }
+
+  // The quadtree's shape, if the quadtree was used.
+  if (CollisionStats_depthNodes[0] > 0) {
+    printf("%-6s %12s %12s\n", "depth", "nodes", "lines");
+    for (int d = 0; d < COLLISIONSTATS_MAX_DEPTH; d++) {
+      if (CollisionStats_depthNodes[d] > 0) {
+        printf("%-6d %12.1f %12.1f\n", d,
+               CollisionStats_depthNodes[d] / frames,
+               CollisionStats_depthLines[d] / frames);
+      }
+    }
+
+    bool any = false;
+    for (int b = 0; b < COLLISIONSTATS_OCCUPANCY_BUCKETS; b++) {
+      if (CollisionStats_occupancy[b] == 0) {
+        continue;
+      }
+      if (!any) {
+        printf("%-18s %s\n", "max-depth leaves", "holding");
+        any = true;
+      }
+      unsigned long lo = b == 0 ? 0 : 1ul << (b - 1);
+      unsigned long hi = b == 0 ? 0 : (1ul << b) - 1;
+      printf("%18.1f %lu", CollisionStats_occupancy[b] / frames, lo);
+      if (hi > lo) {
+        printf("-%lu", hi);
+      }
+      printf(" lines\n");
+    }
+    if (!any) {
+      printf("no leaves at the maximum depth\n");
+    }
+  }
+  printf("---- END COLLISION STATS ----\n");
+}
+
+#endif  // COLLISION_STATS
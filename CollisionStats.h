@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Broad-phase effectiveness counters.  Built with -DCOLLISION_STATS ("make
+// STATS=1"), the pair tests, their early rejects and hits, and the shape of
+// the quadtree are counted every frame, and Screensaver prints per-frame
+// means after the results; otherwise the counting macros expand to nothing.
+#ifndef COLLISIONSTATS_H_
+#define COLLISIONSTATS_H_
+
+#include "./IntersectionDetection.h"
+#include "./Line.h"
+
+// Depths tracked separately; deeper nodes are counted at the last one
+#define COLLISIONSTATS_MAX_DEPTH 32
+// Leaf occupancy buckets: 0 lines, 1, 2-3, 4-7, and so on
+#define COLLISIONSTATS_OCCUPANCY_BUCKETS 33
+
+typedef enum {
+  STAT_PAIRS_SAME_NODE,    // quadtree pairs within one node
+  STAT_PAIRS_ANCESTOR,     // quadtree pairs between a node and an ancestor
+  STAT_PAIRS_STATIC,       // quadtree pairs with a line of the static tree
+  STAT_TESTS,              // pairs given to the intersection test
+  STAT_BOX_REJECTS,        // rejected because the swept boxes are disjoint
+  STAT_DIRECTION_REJECTS,  // rejected by the d1*d2 > 0 && ... test
+  STAT_HITS,               // hits, by IntersectionType, from here on
+  STAT_NUM = STAT_HITS + ALREADY_INTERSECTED + 1
+} Stat;
+
+#ifdef COLLISION_STATS
+
+// Makes the counters.  Called before any frame runs.
+#define STATS_INIT() CollisionStats_init()
+// Adds n to stat for the calling worker.
+#define STATS_ADD(stat, n) CollisionStats_add((stat), (n))
+// Counts the pair tests of one intersectBatch() call and their outcomes.
+#define STATS_COUNT_TESTS(lines, l, candidates, count, types) \
+  CollisionStats_countTests((lines), (l), (candidates), (count), (types))
+// Ends the frame.
+#define STATS_END_FRAME() CollisionStats_endFrame()
+
+void CollisionStats_init();
+
+void CollisionStats_add(Stat stat, unsigned long n);
+
+void CollisionStats_countTests(const LineStore* lines, unsigned int l,
+                               const unsigned int* candidates,
+                               unsigned int count,
+                               const IntersectionType* types);
+
+// Records, for the current frame, a quadtree node at the given depth that
+// holds numOfLines lines.  atMaxDepth is set for nodes that may not split.
+// Only called from the thread that runs the frames.
+void CollisionStats_addNode(unsigned int depth, unsigned int numOfLines,
+                            bool atMaxDepth);
+
+void CollisionStats_endFrame();
+
+// Prints each counter's mean per frame, the lines held at each depth and
+// the occupancy histogram of the leaves at the maximum depth.
+void CollisionStats_print();
+
+#else
+
+#define STATS_INIT()
+#define STATS_ADD(stat, n)
+#define STATS_COUNT_TESTS(lines, l, candidates, count, types)
+#define STATS_END_FRAME()
+
+#endif  // COLLISION_STATS
+
+#endif  // COLLISIONSTATS_H_
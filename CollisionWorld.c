@@ -21,179 +21,325 @@
  * SOFTWARE. 
  **/
 
-#include <cilk/cilk_api.h>
 #include <stdlib.h>
 #include <math.h>
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 
+#include "./BroadPhase.h"
+#include "./CollisionStats.h"
 #include "./CollisionWorld.h"
+#include "./IntersectionBatch.h"
 #include "./IntersectionDetection.h"
 #include "./IntersectionEventList.h"
+#include "./IntersectionEventSort.h"
 #include "./Line.h"
-#include "./Quadtree.h"
+#include "./Parallel.h"
+#include "./PhaseTimer.h"
+#include "./Trace.h"
 
 CollisionWorld* CollisionWorld_new(const unsigned int capacity) {
   assert(capacity > 0);
-  __cilkrts_set_param("nworkers", "8");
+  return CollisionWorld_newWithLines(LineStore_make(capacity));
+}
+
+CollisionWorld* CollisionWorld_newWithLines(LineStore lines) {
+  assert(lines.capacity > 0);
+  intersectBatch_init();
+  STATS_INIT();
+  TRACE_INIT();
 
   CollisionWorld* collisionWorld = malloc(sizeof(CollisionWorld));
   if (collisionWorld == NULL) {
+    LineStore_destroy(&lines);
     return NULL;
   }
 
   collisionWorld->numLineWallCollisions = 0;
   collisionWorld->numLineLineCollisions = 0;
   collisionWorld->timeStep = 0.5;
-  collisionWorld->lines = malloc(capacity * sizeof(Line*));
-  collisionWorld->numOfLines = 0;
+  collisionWorld->lines = lines;
+  collisionWorld->treeArena = Arena_make(ARENA_DEFAULT_CHUNK_SIZE);
+  collisionWorld->staticArena = Arena_make(ARENA_DEFAULT_CHUNK_SIZE);
+  collisionWorld->frameArena = Arena_make(ARENA_DEFAULT_CHUNK_SIZE);
+  collisionWorld->broadPhase = BroadPhase_make(BROADPHASE_QUADTREE,
+                                               &collisionWorld->treeArena,
+                                               &collisionWorld->staticArena);
+  collisionWorld->eventList = IntersectionEventList_make();
+  collisionWorld->lineBatch = calloc(lines.capacity, sizeof(unsigned int));
+  assert(collisionWorld->lineBatch != NULL);
+  collisionWorld->numFrames = 0;
+  collisionWorld->numMallocsAfterFirstFrame = 0;
   return collisionWorld;
 }
 
 void CollisionWorld_delete(CollisionWorld* collisionWorld) {
-  for (int i = 0; i < collisionWorld->numOfLines; i++) {
-    free(collisionWorld->lines[i]);
-  }
-  free(collisionWorld->lines);
+  BroadPhase_destroy(&collisionWorld->broadPhase);
+  IntersectionEventList_destroy(&collisionWorld->eventList);
+  free(collisionWorld->lineBatch);
+  Arena_destroy(&collisionWorld->treeArena);
+  Arena_destroy(&collisionWorld->staticArena);
+  Arena_destroy(&collisionWorld->frameArena);
+  LineStore_destroy(&collisionWorld->lines);
   free(collisionWorld);
 }
 
 unsigned int CollisionWorld_getNumOfLines(CollisionWorld* collisionWorld) {
-  return collisionWorld->numOfLines;
+  return collisionWorld->lines.numOfLines;
 }
 
-void CollisionWorld_addLine(CollisionWorld* collisionWorld, Line *line) {
-  collisionWorld->lines[collisionWorld->numOfLines] = line;
-  collisionWorld->numOfLines++;
+void CollisionWorld_addLine(CollisionWorld* collisionWorld, const Line *line) {
+  LineStore_addLine(&collisionWorld->lines, line);
 }
 
-Line* CollisionWorld_getLine(CollisionWorld* collisionWorld,
-                             const unsigned int index) {
-  if (index >= collisionWorld->numOfLines) {
-    return NULL;
-  }
-  return collisionWorld->lines[index];
+Line CollisionWorld_getLine(CollisionWorld* collisionWorld,
+                            const unsigned int index) {
+  return LineStore_getLine(&collisionWorld->lines, index);
+}
+
+void CollisionWorld_setQuadtreeParams(CollisionWorld* collisionWorld,
+                                      QuadtreeParams params) {
+  BroadPhase_setQuadtreeParams(&collisionWorld->broadPhase, params);
+}
+
+void CollisionWorld_setBroadPhase(CollisionWorld* collisionWorld,
+                                  BroadPhaseType type) {
+  BroadPhase_setType(&collisionWorld->broadPhase, type);
+}
+
+// Calls to malloc made so far by the arenas, the event list and the broad
+// phase, the memory that frames use
+static unsigned long count_mallocs(const CollisionWorld* collisionWorld) {
+  return collisionWorld->treeArena.numMallocs
+      + collisionWorld->staticArena.numMallocs
+      + collisionWorld->frameArena.numMallocs
+      + IntersectionEventList_getNumMallocs(&collisionWorld->eventList)
+      + BroadPhase_getNumMallocs(&collisionWorld->broadPhase);
 }
 
 void CollisionWorld_updateLines(CollisionWorld* collisionWorld) {
+  unsigned long mallocs = count_mallocs(collisionWorld);
+
   CollisionWorld_detectIntersection(collisionWorld);
-  CollisionWorld_updatePosition(collisionWorld);
-  CollisionWorld_lineWallCollision(collisionWorld);
+  PHASE_START(moveTimer);
+  CollisionWorld_moveLines(collisionWorld);
+  PHASE_STOP(moveTimer, PHASE_MOVE);
+  PHASE_START(teardownTimer);
+  Arena_reset(&collisionWorld->frameArena);
+  PHASE_STOP(teardownTimer, PHASE_TEARDOWN);
+  PHASE_END_FRAME();
+  STATS_END_FRAME();
+
+  if (collisionWorld->numFrames > 0) {
+    collisionWorld->numMallocsAfterFirstFrame +=
+        count_mallocs(collisionWorld) - mallocs;
+  }
+  collisionWorld->numFrames++;
 }
 
-void CollisionWorld_updatePosition(CollisionWorld* collisionWorld) {
-  double t = collisionWorld->timeStep;
-  for (int i = 0; i < collisionWorld->numOfLines; i++) {
-    Line *line = collisionWorld->lines[i];
-    double dx = line->velocity.x * t;
-    double dy = line->velocity.y * t;
-    line->p1.x += dx;
-    line->p1.y += dy;
-    line->p2.x += dx;
-    line->p2.y += dy;
-    line->top_left.x += dx;
-    line->top_left.y += dy;
-    line->bottom_right.x += dx;
-    line->bottom_right.y += dy;
+typedef struct {
+  LineStore* lines;
+  double timeStep;
+} MoveContext;
+
+// Moves lines [begin, end) and bounces them off the walls.  Returns the
+// number of lines that hit a wall.  Each flip is applied in the same order,
+// and to the same updated endpoints, as the separate passes this replaces.
+// The loop body has no branches, and uses quiet comparisons that cannot
+// trap, so that the compiler can vectorize it.
+static inline __attribute__((always_inline))
+unsigned long moveLines(const MoveContext* move, unsigned int begin,
+                        unsigned int end) {
+  double t = move->timeStep;
+  Vec* restrict p1 = move->lines->p1;
+  Vec* restrict p2 = move->lines->p2;
+  Vec* restrict velocity = move->lines->velocity;
+  Vec* restrict top_left = move->lines->top_left;
+  Vec* restrict bottom_right = move->lines->bottom_right;
+
+  unsigned long numCollisions = 0;
+  for (unsigned int i = begin; i < end; i++) {
+    double vx = velocity[i].x;
+    double vy = velocity[i].y;
+    double dx = vx * t;
+    double dy = vy * t;
+    double x1 = p1[i].x + dx;
+    double y1 = p1[i].y + dy;
+    double x2 = p2[i].x + dx;
+    double y2 = p2[i].y + dy;
+    p1[i].x = x1;
+    p1[i].y = y1;
+    p2[i].x = x2;
+    p2[i].y = y2;
+    top_left[i].x += dx;
+    top_left[i].y += dy;
+    bottom_right[i].x += dx;
+    bottom_right[i].y += dy;
+
+    // Right, left, top and bottom walls.
+    long right = isgreater(x1, BOX_XMAX) | isgreater(x2, BOX_XMAX);
+    right &= isgreater(vx, 0);
+    vx = right ? -vx : vx;
+    long left = isless(x1, BOX_XMIN) | isless(x2, BOX_XMIN);
+    left &= isless(vx, 0);
+    vx = left ? -vx : vx;
+    long top = isgreater(y1, BOX_YMAX) | isgreater(y2, BOX_YMAX);
+    top &= isgreater(vy, 0);
+    vy = top ? -vy : vy;
+    long bottom = isless(y1, BOX_YMIN) | isless(y2, BOX_YMIN);
+    bottom &= isless(vy, 0);
+    vy = bottom ? -vy : vy;
+    velocity[i].x = vx;
+    velocity[i].y = vy;
+
+    numCollisions += right | left | top | bottom;
   }
+  return numCollisions;
 }
 
-void CollisionWorld_lineWallCollision(CollisionWorld* collisionWorld) {
-  for (int i = 0; i < collisionWorld->numOfLines; i++) {
-    Line *line = collisionWorld->lines[i];
-    bool collide = false;
+static unsigned long moveRange(void* context, unsigned int begin,
+                               unsigned int end) {
+  return moveLines(context, begin, end);
+}
 
-    // Right side
-    if ((line->p1.x > BOX_XMAX || line->p2.x > BOX_XMAX)
-        && (line->velocity.x > 0)) {
-      line->velocity.x = -line->velocity.x;
-      collide = true;
-    }
-    // Left side
-    if ((line->p1.x < BOX_XMIN || line->p2.x < BOX_XMIN)
-        && (line->velocity.x < 0)) {
-      line->velocity.x = -line->velocity.x;
-      collide = true;
-    }
-    // Top side
-    if ((line->p1.y > BOX_YMAX || line->p2.y > BOX_YMAX)
-        && (line->velocity.y > 0)) {
-      line->velocity.y = -line->velocity.y;
-      collide = true;
-    }
-    // Bottom side
-    if ((line->p1.y < BOX_YMIN || line->p2.y < BOX_YMIN)
-        && (line->velocity.y < 0)) {
-      line->velocity.y = -line->velocity.y;
-      collide = true;
-    }
-    // Update total number of collisions.
-    if (collide == true) {
-      collisionWorld->numLineWallCollisions++;
-    }
+#if defined(__x86_64__) || defined(__i386__)
+// The same loop, vectorized with 256-bit registers.  The baseline SSE2 has
+// no cheap way to turn a comparison mask into a count, so the generic
+// version is left to the compiler's straight-line vectorizer.
+__attribute__((target("avx2")))
+static unsigned long moveRange_avx2(void* context, unsigned int begin,
+                                    unsigned int end) {
+  return moveLines(context, begin, end);
+}
+#endif
+
+void CollisionWorld_moveLines(CollisionWorld* collisionWorld) {
+  MoveContext move = {
+    .lines = &collisionWorld->lines, .timeStep = collisionWorld->timeStep
+  };
+  ParallelSumBody body = moveRange;
+#if defined(__x86_64__) || defined(__i386__)
+  if (__builtin_cpu_supports("avx2")) {
+    body = moveRange_avx2;
   }
+#endif
+  collisionWorld->numLineWallCollisions += Parallel_sum(
+      collisionWorld->lines.numOfLines, COLLISIONWORLD_LINE_GRAIN, body,
+      &move);
 }
 
-void CollisionWorld_detectIntersection(CollisionWorld* collisionWorld) {
-  IntersectionEventList_reducer reducer = CILK_C_INIT_REDUCER(
-    IntersectionEventList,
-    IntersectionEventList_reduce,
-    IntersectionEventList_identity,
-    IntersectionEventList_destroy,
-    IntersectionEventList_make()
-  );
-
-  // create the quadtree array
-  int numQuadtrees = 0;
-  int * pnumQuadtrees = &numQuadtrees;
-  int size = 0;
-  for (int i = 0; i <= MAX_DEPTH; i++) {
-    size += (int) pow(4, i);
+typedef struct {
+  CollisionWorld* collisionWorld;
+  const IntersectionEvent* events;
+} SolveContext;
+
+static void solveRange(void* context, unsigned int begin, unsigned int end) {
+  SolveContext* solve = context;
+  for (unsigned int i = begin; i < end; i++) {
+    const IntersectionEvent* event = &solve->events[i];
+    CollisionWorld_collisionSolver(solve->collisionWorld, event->l1,
+                                   event->l2, event->intersectionType);
   }
-  Quadtree ** quadtrees = malloc(sizeof(Quadtree *) * size);
+}
 
-  CILK_C_REGISTER_REDUCER(reducer);
+// Solves the numEvents events, sorted by line IDs, with the same results as
+// solving them one at a time in order.  Each event only reads and writes
+// its own two lines, so the events are split into batches in which no line
+// appears twice, and each batch is solved in parallel.  An event goes in the
+// batch after the last one holding either of its lines, which keeps every
+// line's events in their original order.  Batches too small to split are
+// solved on the calling thread.  batched must have room for numEvents
+// events.
+static void solveEvents(CollisionWorld* collisionWorld,
+                        const IntersectionEvent* events,
+                        IntersectionEvent* batched, unsigned int numEvents) {
+  if (numEvents == 0) {
+    return;
+  }
+  Arena* arena = &collisionWorld->frameArena;
+
+  // lineBatch[l] is the batch after the last one holding line l so far.
+  unsigned int* lineBatch = collisionWorld->lineBatch;
+  unsigned int* eventBatch = Arena_alloc(arena,
+                                         sizeof(unsigned int) * numEvents);
+  unsigned int numBatches = 0;
+  for (unsigned int i = 0; i < numEvents; i++) {
+    unsigned int l1 = events[i].l1;
+    unsigned int l2 = events[i].l2;
+    unsigned int batch = MAX(lineBatch[l1], lineBatch[l2]);
+    eventBatch[i] = batch;
+    lineBatch[l1] = lineBatch[l2] = batch + 1;
+    numBatches = MAX(numBatches, batch + 1);
+  }
+  for (unsigned int i = 0; i < numEvents; i++) {
+    lineBatch[events[i].l1] = lineBatch[events[i].l2] = 0;
+  }
 
-  // insert lines into the quadtree
-  Quadtree * tree = parse_CollisionWorld_to_Quadtree(collisionWorld, quadtrees, pnumQuadtrees);
+  // Lay the batches out one after another, keeping the sorted order within
+  // each.
+  unsigned int* batchStart = Arena_alloc(
+      arena, sizeof(unsigned int) * (numBatches + 1));
+  memset(batchStart, 0, sizeof(unsigned int) * (numBatches + 1));
+  for (unsigned int i = 0; i < numEvents; i++) {
+    batchStart[eventBatch[i] + 1]++;
+  }
+  for (unsigned int b = 0; b < numBatches; b++) {
+    batchStart[b + 1] += batchStart[b];
+  }
+  for (unsigned int i = 0; i < numEvents; i++) {
+    batched[batchStart[eventBatch[i]]++] = events[i];
+  }
 
-  // calculate the number of collisions
-  detect_collisions(&reducer, quadtrees, pnumQuadtrees);
-
-  // clean up the quadtree
-  delete_Quadtree(tree);
-
-  IntersectionEventList intersectionEventList = reducer.value;
-  CILK_C_UNREGISTER_REDUCER(reducer);
-  collisionWorld->numLineLineCollisions += intersectionEventList.size;
-
-  // Sort the intersection event list.
-  IntersectionEventNode* startNode = intersectionEventList.head;
-  while (startNode != NULL) {
-    IntersectionEventNode* minNode = startNode;
-    IntersectionEventNode* curNode = startNode->next;
-    while (curNode != NULL) {
-      if (IntersectionEventNode_compareData(curNode, minNode) < 0) {
-        minNode = curNode;
-      }
-      curNode = curNode->next;
-    }
-    if (minNode != startNode) {
-      IntersectionEventNode_swapData(minNode, startNode);
+  unsigned int start = 0;
+  for (unsigned int b = 0; b < numBatches; b++) {
+    unsigned int end = batchStart[b];
+    SolveContext solve = {
+      .collisionWorld = collisionWorld, .events = batched + start
+    };
+    if (end - start < COLLISIONWORLD_SOLVE_GRAIN) {
+      solveRange(&solve, 0, end - start);
+    } else {
+      Parallel_for(end - start, COLLISIONWORLD_SOLVE_GRAIN, solveRange,
+                   &solve);
     }
-    startNode = startNode->next;
+    start = end;
   }
+}
 
-  // Call the collision solver for each intersection event.
-  IntersectionEventNode* curNode = intersectionEventList.head;
+void CollisionWorld_detectIntersection(CollisionWorld* collisionWorld) {
+  IntersectionEventList* eventList = &collisionWorld->eventList;
+  IntersectionEventList_clear(eventList);
 
-  while (curNode != NULL) {
-    CollisionWorld_collisionSolver(collisionWorld, curNode->l1, curNode->l2,
-                                   curNode->intersectionType);
-    curNode = curNode->next;
-  }
+  // calculate the number of collisions
+  BroadPhase_detectCollisions(&collisionWorld->broadPhase, eventList,
+                              &collisionWorld->lines,
+                              &collisionWorld->frameArena);
+
+  unsigned int numEvents = IntersectionEventList_size(eventList);
+  collisionWorld->numLineLineCollisions += numEvents;
+
+  // Flatten the events and sort them by line IDs, in memory that lasts
+  // until the end of the frame.
+  IntersectionEvent* buffer = Arena_alloc(
+      &collisionWorld->frameArena, sizeof(IntersectionEvent) * numEvents);
+  IntersectionEvent* scratch = Arena_alloc(
+      &collisionWorld->frameArena, sizeof(IntersectionEvent) * numEvents);
+  PHASE_START(mergeTimer);
+  IntersectionEventList_toArray(eventList, buffer);
+  PHASE_STOP(mergeTimer, PHASE_MERGE);
+  PHASE_START(sortTimer);
+  IntersectionEvent* events = IntersectionEvent_sort(
+      buffer, scratch, numEvents, collisionWorld->lines.numOfLines);
+  PHASE_STOP(sortTimer, PHASE_SORT);
 
-  IntersectionEventList_deleteNodes(&intersectionEventList);
+  // Call the collision solver for each intersection event.
+  PHASE_START(solveTimer);
+  solveEvents(collisionWorld, events, events == buffer ? scratch : buffer,
+              numEvents);
+  BroadPhase_solved(&collisionWorld->broadPhase, &collisionWorld->lines,
+                    events, numEvents);
+  PHASE_STOP(solveTimer, PHASE_SOLVE);
 }
 
 unsigned int CollisionWorld_getNumLineWallCollisions(
@@ -206,14 +352,25 @@ unsigned int CollisionWorld_getNumLineLineCollisions(
   return collisionWorld->numLineLineCollisions;
 }
 
+double CollisionWorld_getPairsTestedPerFrame(CollisionWorld* collisionWorld) {
+  return BroadPhase_getPairsTestedPerFrame(&collisionWorld->broadPhase);
+}
+
+unsigned long CollisionWorld_getMallocsAfterFirstFrame(
+    CollisionWorld* collisionWorld) {
+  return collisionWorld->numMallocsAfterFirstFrame;
+}
+
 void CollisionWorld_collisionSolver(CollisionWorld* collisionWorld,
-                                    Line *l1, Line *l2,
+                                    unsigned int l1, unsigned int l2,
                                     IntersectionType intersectionType) {
-  assert(compareLines(l1, l2) < 0);
+  assert(l1 < l2);
   assert(intersectionType == L1_WITH_L2
          || intersectionType == L2_WITH_L1
          || intersectionType == ALREADY_INTERSECTED);
 
+  LineStore* lines = &collisionWorld->lines;
+
   // Despite our efforts to determine whether lines will intersect ahead
   // of time (and to modify their velocities appropriately), our
   // simplified model can sometimes cause lines to intersect.  In such a
@@ -221,23 +378,27 @@ void CollisionWorld_collisionSolver(CollisionWorld* collisionWorld,
   // the fastest possible way, while still conserving momentum and kinetic
   // energy.
   if (intersectionType == ALREADY_INTERSECTED) {
-    Vec p = getIntersectionPoint(l1->p1, l1->p2, l2->p1, l2->p2);
-
-    if (Vec_length(Vec_subtract(l1->p1, p))
-        < Vec_length(Vec_subtract(l1->p2, p))) {
-      l1->velocity = Vec_multiply(Vec_normalize(Vec_subtract(l1->p2, p)),
-                                  Vec_length(l1->velocity));
+    Vec l1p1 = lines->p1[l1];
+    Vec l1p2 = lines->p2[l1];
+    Vec l2p1 = lines->p1[l2];
+    Vec l2p2 = lines->p2[l2];
+    Vec p = getIntersectionPoint(l1p1, l1p2, l2p1, l2p2);
+
+    if (Vec_length(Vec_subtract(l1p1, p))
+        < Vec_length(Vec_subtract(l1p2, p))) {
+      lines->velocity[l1] = Vec_multiply(Vec_normalize(Vec_subtract(l1p2, p)),
+                                         Vec_length(lines->velocity[l1]));
     } else {
-      l1->velocity = Vec_multiply(Vec_normalize(Vec_subtract(l1->p1, p)),
-                                  Vec_length(l1->velocity));
+      lines->velocity[l1] = Vec_multiply(Vec_normalize(Vec_subtract(l1p1, p)),
+                                         Vec_length(lines->velocity[l1]));
     }
-    if (Vec_length(Vec_subtract(l2->p1, p))
-        < Vec_length(Vec_subtract(l2->p2, p))) {
-      l2->velocity = Vec_multiply(Vec_normalize(Vec_subtract(l2->p2, p)),
-                                  Vec_length(l2->velocity));
+    if (Vec_length(Vec_subtract(l2p1, p))
+        < Vec_length(Vec_subtract(l2p2, p))) {
+      lines->velocity[l2] = Vec_multiply(Vec_normalize(Vec_subtract(l2p2, p)),
+                                         Vec_length(lines->velocity[l2]));
     } else {
-      l2->velocity = Vec_multiply(Vec_normalize(Vec_subtract(l2->p1, p)),
-                                  Vec_length(l2->velocity));
+      lines->velocity[l2] = Vec_multiply(Vec_normalize(Vec_subtract(l2p1, p)),
+                                         Vec_length(lines->velocity[l2]));
     }
     return;
   }
@@ -246,24 +407,24 @@ void CollisionWorld_collisionSolver(CollisionWorld* collisionWorld,
   Vec face;
   Vec normal;
   if (intersectionType == L1_WITH_L2) {
-    Vec v = l2->relative_vector;
+    Vec v = lines->relative_vector[l2];
     face = Vec_normalize(v);
   } else {
-    Vec v = l1->relative_vector;
+    Vec v = lines->relative_vector[l1];
     face = Vec_normalize(v);
   }
   normal = Vec_orthogonal(face);
 
   // Obtain each line's velocity components with respect to the collision
   // face/normal vectors.
-  double v1Face = Vec_dotProduct(l1->velocity, face);
-  double v2Face = Vec_dotProduct(l2->velocity, face);
-  double v1Normal = Vec_dotProduct(l1->velocity, normal);
-  double v2Normal = Vec_dotProduct(l2->velocity, normal);
+  double v1Face = Vec_dotProduct(lines->velocity[l1], face);
+  double v2Face = Vec_dotProduct(lines->velocity[l2], face);
+  double v1Normal = Vec_dotProduct(lines->velocity[l1], normal);
+  double v2Normal = Vec_dotProduct(lines->velocity[l2], normal);
 
   // Compute the mass of each line (we simply use its length).
-  double m1 = Vec_length(l1->relative_vector);
-  double m2 = Vec_length(l2->relative_vector);
+  double m1 = Vec_length(lines->relative_vector[l1]);
+  double m2 = Vec_length(lines->relative_vector[l2]);
 
   // Perform the collision calculation (computes the new velocities along
   // the direction normal to the collision face such that momentum and
@@ -274,10 +435,10 @@ void CollisionWorld_collisionSolver(CollisionWorld* collisionWorld,
       + ((m2 - m1) / (m2 + m1)) * v2Normal;
 
   // Combine the resulting velocities.
-  l1->velocity = Vec_add(Vec_multiply(normal, newV1Normal),
-                         Vec_multiply(face, v1Face));
-  l2->velocity = Vec_add(Vec_multiply(normal, newV2Normal),
-                         Vec_multiply(face, v2Face));
+  lines->velocity[l1] = Vec_add(Vec_multiply(normal, newV1Normal),
+                                Vec_multiply(face, v1Face));
+  lines->velocity[l2] = Vec_add(Vec_multiply(normal, newV2Normal),
+                                Vec_multiply(face, v2Face));
 
   return;
 }
@@ -24,49 +24,92 @@
 #ifndef COLLISIONWORLD_H_
 #define COLLISIONWORLD_H_
 
+#include "./Arena.h"
 #include "./Line.h"
 #include "./IntersectionDetection.h"
+#include "./IntersectionEventList.h"
+#include "./BroadPhase.h"
+
+// Events each worker takes at a time when solving a batch of collisions
+#define COLLISIONWORLD_SOLVE_GRAIN 64
+
+// Lines each worker takes at a time when moving the lines
+#define COLLISIONWORLD_LINE_GRAIN 4096
 
 struct CollisionWorld {
   // Time step used for simulation
   double timeStep;
 
-  // Container that holds all the lines as an array of Line* lines.
-  // This CollisionWorld owns the Line* lines.
-  Line** lines;
-  unsigned int numOfLines;
+  // Structure-of-arrays storage for all the lines, indexed by line ID.
+  LineStore lines;
+
+  // Finds the pairs of lines that may intersect each frame.
+  BroadPhase broadPhase;
+
+  // Memory of the broad phase's quadtree, reset when the tree is rebuilt.
+  Arena treeArena;
+
+  // Memory of the broad phase's static tree, reset when it is rebuilt.
+  Arena staticArena;
+
+  // Memory needed only during one frame, reset at the end of each frame.
+  Arena frameArena;
+
+  // Per-worker buffers the broad phase appends a frame's intersection
+  // events to, kept across frames.
+  IntersectionEventList eventList;
+
+  // For each line, the batch after the last one holding it while a frame's
+  // events are split into batches.  Zero between frames.
+  unsigned int* lineBatch;
 
   // Record the total number of line-wall collisions.
   unsigned int numLineWallCollisions;
 
   // Record the total number of line-line intersections.
   unsigned int numLineLineCollisions;
+
+  // Number of frames run, and the number of times the arenas, the event list
+  // and the broad phase called malloc or realloc after the first frame.
+  // Once they have grown to a frame's needs, frames do not allocate.
+  unsigned int numFrames;
+  unsigned long numMallocsAfterFirstFrame;
 };
 typedef struct CollisionWorld CollisionWorld;
 
 CollisionWorld* CollisionWorld_new(const unsigned int capacity);
 
+// Returns a world simulating the lines already in the store, which the world
+// takes ownership of.
+CollisionWorld* CollisionWorld_newWithLines(LineStore lines);
+
 void CollisionWorld_delete(CollisionWorld* collisionWorld);
 
 // Return the total number of lines in the box.
 unsigned int CollisionWorld_getNumOfLines(CollisionWorld* collisionWorld);
 
-// Add a line into the box.  Must be under capacity.
-// This CollisionWorld becomes owner of the Line* line.
-void CollisionWorld_addLine(CollisionWorld* collisionWorld, Line *line);
+// Add a line into the box.  Must be under capacity, and line->id must equal
+// the current number of lines.  The line is copied into the world's storage.
+void CollisionWorld_addLine(CollisionWorld* collisionWorld, const Line *line);
+
+// Get a copy of a line from box.
+Line CollisionWorld_getLine(CollisionWorld* collisionWorld,
+                            const unsigned int index);
+
+// Set the limits on the quadtree's shape.  If the quadtree has already been
+// built, it is rebuilt with the new limits on the next frame.
+void CollisionWorld_setQuadtreeParams(CollisionWorld* collisionWorld,
+                                      QuadtreeParams params);
 
-// Get a line from box.
-Line* CollisionWorld_getLine(CollisionWorld* collisionWorld,
-                             const unsigned int index);
+// Select the broad-phase engine used to find candidate pairs.
+void CollisionWorld_setBroadPhase(CollisionWorld* collisionWorld,
+                                  BroadPhaseType type);
 
 // Update lines' situation in the box.
 void CollisionWorld_updateLines(CollisionWorld* collisionWorld);
 
-// Update position of lines.
-void CollisionWorld_updatePosition(CollisionWorld* collisionWorld);
-
-// Handle line-wall collision.
-void CollisionWorld_lineWallCollision(CollisionWorld* collisionWorld);
+// Update position of lines and handle line-wall collision, in one pass.
+void CollisionWorld_moveLines(CollisionWorld* collisionWorld);
 
 // Detect line-line intersection.
 void CollisionWorld_detectIntersection(CollisionWorld* collisionWorld);
@@ -79,10 +122,18 @@ unsigned int CollisionWorld_getNumLineWallCollisions(
 unsigned int CollisionWorld_getNumLineLineCollisions(
     CollisionWorld* collisionWorld);
 
+// Get the mean number of line pairs tested for intersection per frame.
+double CollisionWorld_getPairsTestedPerFrame(CollisionWorld* collisionWorld);
+
+// Get the number of times the memory frames use was allocated or grown
+// after the first frame.
+unsigned long CollisionWorld_getMallocsAfterFirstFrame(
+    CollisionWorld* collisionWorld);
+
 // Update the two lines based on their intersection event.
-// Precondition: compareLines(l1, l2) < 0 must be true.
-void CollisionWorld_collisionSolver(CollisionWorld* collisionWorld, Line *l1,
-                                    Line *l2,
+// Precondition: l1 < l2 must be true.
+void CollisionWorld_collisionSolver(CollisionWorld* collisionWorld,
+                                    unsigned int l1, unsigned int l2,
                                     IntersectionType intersectionType);
 
 #endif  // COLLISIONWORLD_H_
@@ -0,0 +1,544 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "./IntersectionBatch.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./CollisionStats.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define INTERSECT_HAVE_X86 1
+#endif
+
+// The vector kernels must round exactly like intersect(), so they rely on
+// the Makefile's -ffp-contract=off: a fused multiply-add would change the
+// sign of direction() for nearly collinear points.
+#define AVX2_TARGET __attribute__((target("avx2")))
+#define AVX512_TARGET __attribute__((target("avx512f")))
+
+typedef unsigned int (*IntersectBatchKernel)(const LineStore* lines,
+                                             unsigned int l,
+                                             const unsigned int* candidates,
+                                             unsigned int count,
+                                             IntersectionType* types);
+
+// Outcome of the branch conditions of intersect(), one bit per lane.
+typedef struct {
+  unsigned int reject;         // swept boxes disjoint, or d1*d2 > 0 &&
+                               // d2*d3 > 0 && d3*d4 > 0
+  unsigned int already;        // intersectLines(d1*d2, d5*d6)
+  unsigned int top;            // intersectLines(d3*d1, d7*d8)
+  unsigned int bottom;         // intersectLines(d4*d2, d9*d10)
+  unsigned int third;          // intersectLines(d3*d4, d11*d12)
+  unsigned int parallelogram;  // both endpoints of l1 in the parallelogram
+} LaneMasks;
+
+// Tests one pair with the scalar kernel, ordering it by ID first.
+static inline IntersectionType intersectOrdered(const LineStore* lines,
+                                                unsigned int l,
+                                                unsigned int candidate) {
+  return l < candidate ? intersect(lines, l, candidate)
+                       : intersect(lines, candidate, l);
+}
+
+// Turns the branch conditions of the first lanes lanes into
+// IntersectionTypes, following the same decision order as intersect().
+static unsigned int resolveLanes(const LineStore* lines, unsigned int l,
+                                 const unsigned int* candidates,
+                                 unsigned int lanes, LaneMasks m,
+                                 IntersectionType* types) {
+  unsigned int hits = 0;
+  for (unsigned int k = 0; k < lanes; k++) {
+    unsigned int bit = 1u << k;
+    IntersectionType type;
+    if (m.reject & bit) {
+      type = NO_INTERSECTION;
+    } else if (m.already & bit) {
+      type = ALREADY_INTERSECTED;
+    } else {
+      int num_line_intersections = ((m.top & bit) != 0)
+          + ((m.bottom & bit) != 0) + ((m.third & bit) != 0);
+      if (num_line_intersections == 2) {
+        type = L2_WITH_L1;
+      } else if (m.parallelogram & bit) {
+        type = L1_WITH_L2;
+      } else if (num_line_intersections == 0) {
+        type = NO_INTERSECTION;
+      } else {
+        // The remaining case compares the lines' angles with atan2, which
+        // is rare enough to leave to the scalar kernel.
+        type = intersectOrdered(lines, l, candidates[k]);
+      }
+    }
+    types[k] = type;
+    if (type != NO_INTERSECTION) {
+      hits |= bit;
+    }
+  }
+  return hits;
+}
+
+static unsigned int intersectBatch_scalar(const LineStore* lines,
+                                          unsigned int l,
+                                          const unsigned int* candidates,
+                                          unsigned int count,
+                                          IntersectionType* types) {
+  unsigned int hits = 0;
+  for (unsigned int k = 0; k < count; k++) {
+    types[k] = intersectOrdered(lines, l, candidates[k]);
+    if (types[k] != NO_INTERSECTION) {
+      hits |= 1u << k;
+    }
+  }
+  return hits;
+}
+
+#ifdef INTERSECT_HAVE_X86
+
+// ********************************* AVX2 ***********************************
+
+// direction() on four lanes.
+AVX2_TARGET
+static inline __m256d direction_avx2(__m256d pix, __m256d piy,
+                                     __m256d pjx, __m256d pjy,
+                                     __m256d pkx, __m256d pky) {
+  return _mm256_sub_pd(
+      _mm256_mul_pd(_mm256_sub_pd(pkx, pix), _mm256_sub_pd(pjy, piy)),
+      _mm256_mul_pd(_mm256_sub_pd(pky, piy), _mm256_sub_pd(pjx, pix)));
+}
+
+// Mask of the lanes where a * b compares to zero with the predicate cmp.
+#define PRODUCT_MASK_AVX2(a, b, cmp)                                   \
+  ((unsigned int) _mm256_movemask_pd(                                  \
+      _mm256_cmp_pd(_mm256_mul_pd((a), (b)), _mm256_setzero_pd(), (cmp))))
+
+// Tests line l against the four candidates; only the first lanes results are
+// kept.
+AVX2_TARGET
+static unsigned int intersect4_avx2(const LineStore* lines, unsigned int l,
+                                    const unsigned int* candidates,
+                                    unsigned int lanes,
+                                    IntersectionType* types) {
+  const double* p1 = (const double*) lines->p1;
+  const double* p2 = (const double*) lines->p2;
+  const double* velocity = (const double*) lines->velocity;
+  const double* top_left = (const double*) lines->top_left;
+  const double* bottom_right = (const double*) lines->bottom_right;
+  unsigned int laneMask = (1u << lanes) - 1;
+
+  // Gather the candidates' bounding boxes and velocities.  Each Vec is two
+  // doubles, so the x coordinate of line i is double 2 * i.
+  __m128i ids = _mm_loadu_si128((const __m128i*) candidates);
+  __m128i xs = _mm_slli_epi32(ids, 1);
+  __m256d cvx = _mm256_i32gather_pd(velocity, xs, 8);
+  __m256d cvy = _mm256_i32gather_pd(velocity + 1, xs, 8);
+  __m256d ctlx = _mm256_i32gather_pd(top_left, xs, 8);
+  __m256d ctly = _mm256_i32gather_pd(top_left + 1, xs, 8);
+  __m256d cbrx = _mm256_i32gather_pd(bottom_right, xs, 8);
+  __m256d cbry = _mm256_i32gather_pd(bottom_right + 1, xs, 8);
+
+  // Test the swept boxes as sweptBoxesOverlap() does.  _mm256_min_pd and
+  // _mm256_max_pd select exactly like the MIN and MAX macros.
+  Vec tl = lines->top_left[l];
+  Vec br = lines->bottom_right[l];
+  Vec v = lines->velocity[l];
+  __m256d loX = _mm256_set1_pd(MIN(tl.x, tl.x + v.x));
+  __m256d loY = _mm256_set1_pd(MIN(tl.y, tl.y + v.y));
+  __m256d hiX = _mm256_set1_pd(MAX(br.x, br.x + v.x));
+  __m256d hiY = _mm256_set1_pd(MAX(br.y, br.y + v.y));
+  __m256d cLoX = _mm256_min_pd(ctlx, _mm256_add_pd(ctlx, cvx));
+  __m256d cLoY = _mm256_min_pd(ctly, _mm256_add_pd(ctly, cvy));
+  __m256d cHiX = _mm256_max_pd(cbrx, _mm256_add_pd(cbrx, cvx));
+  __m256d cHiY = _mm256_max_pd(cbry, _mm256_add_pd(cbry, cvy));
+  __m256d overlap = _mm256_and_pd(
+      _mm256_and_pd(_mm256_cmp_pd(loX, cHiX, _CMP_LE_OQ),
+                    _mm256_cmp_pd(cLoX, hiX, _CMP_LE_OQ)),
+      _mm256_and_pd(_mm256_cmp_pd(loY, cHiY, _CMP_LE_OQ),
+                    _mm256_cmp_pd(cLoY, hiY, _CMP_LE_OQ)));
+  unsigned int disjoint = ~(unsigned int) _mm256_movemask_pd(overlap) & 0xF;
+  if ((disjoint & laneMask) == laneMask) {
+    for (unsigned int k = 0; k < lanes; k++) {
+      types[k] = NO_INTERSECTION;
+    }
+    return 0;
+  }
+
+  // Gather the candidates' endpoints.
+  __m256d c1x = _mm256_i32gather_pd(p1, xs, 8);
+  __m256d c1y = _mm256_i32gather_pd(p1 + 1, xs, 8);
+  __m256d c2x = _mm256_i32gather_pd(p2, xs, 8);
+  __m256d c2y = _mm256_i32gather_pd(p2 + 1, xs, 8);
+
+  __m256d a1x = _mm256_set1_pd(lines->p1[l].x);
+  __m256d a1y = _mm256_set1_pd(lines->p1[l].y);
+  __m256d a2x = _mm256_set1_pd(lines->p2[l].x);
+  __m256d a2y = _mm256_set1_pd(lines->p2[l].y);
+  __m256d avx = _mm256_set1_pd(lines->velocity[l].x);
+  __m256d avy = _mm256_set1_pd(lines->velocity[l].y);
+
+  // In lanes where the candidate's ID is below l's, the candidate plays the
+  // role of l1.  The XOR with INT_MIN turns the signed compare unsigned.
+  __m128i bias = _mm_set1_epi32(INT_MIN);
+  __m128i swap32 = _mm_cmpgt_epi32(_mm_xor_si128(_mm_set1_epi32((int) l), bias),
+                                   _mm_xor_si128(ids, bias));
+  __m256d swap = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(swap32));
+
+  __m256d l1p1x = _mm256_blendv_pd(a1x, c1x, swap);
+  __m256d l1p1y = _mm256_blendv_pd(a1y, c1y, swap);
+  __m256d l1p2x = _mm256_blendv_pd(a2x, c2x, swap);
+  __m256d l1p2y = _mm256_blendv_pd(a2y, c2y, swap);
+  __m256d l1vx = _mm256_blendv_pd(avx, cvx, swap);
+  __m256d l1vy = _mm256_blendv_pd(avy, cvy, swap);
+  __m256d l2p1x = _mm256_blendv_pd(c1x, a1x, swap);
+  __m256d l2p1y = _mm256_blendv_pd(c1y, a1y, swap);
+  __m256d l2p2x = _mm256_blendv_pd(c2x, a2x, swap);
+  __m256d l2p2y = _mm256_blendv_pd(c2y, a2y, swap);
+  __m256d l2vx = _mm256_blendv_pd(cvx, avx, swap);
+  __m256d l2vy = _mm256_blendv_pd(cvy, avy, swap);
+
+  // Get relative velocity.
+  __m256d half = _mm256_set1_pd(0.5);
+  __m256d dx = _mm256_mul_pd(_mm256_sub_pd(l2vx, l1vx), half);
+  __m256d dy = _mm256_mul_pd(_mm256_sub_pd(l2vy, l1vy), half);
+
+  // Get the parallelogram.
+  __m256d q1x = _mm256_add_pd(l2p1x, dx);
+  __m256d q1y = _mm256_add_pd(l2p1y, dy);
+  __m256d q2x = _mm256_add_pd(l2p2x, dx);
+  __m256d q2y = _mm256_add_pd(l2p2y, dy);
+
+  __m256d d1 = direction_avx2(l1p1x, l1p1y, l1p2x, l1p2y, l2p1x, l2p1y);
+  __m256d d2 = direction_avx2(l1p1x, l1p1y, l1p2x, l1p2y, l2p2x, l2p2y);
+  __m256d d3 = direction_avx2(l1p1x, l1p1y, l1p2x, l1p2y, q1x, q1y);
+  __m256d d4 = direction_avx2(l1p1x, l1p1y, l1p2x, l1p2y, q2x, q2y);
+
+  LaneMasks m;
+  m.reject = disjoint | (PRODUCT_MASK_AVX2(d1, d2, _CMP_GT_OQ)
+      & PRODUCT_MASK_AVX2(d2, d3, _CMP_GT_OQ)
+      & PRODUCT_MASK_AVX2(d3, d4, _CMP_GT_OQ));
+  if ((m.reject & laneMask) == laneMask) {
+    for (unsigned int k = 0; k < lanes; k++) {
+      types[k] = NO_INTERSECTION;
+    }
+    return 0;
+  }
+
+  __m256d d5 = direction_avx2(l2p1x, l2p1y, l2p2x, l2p2y, l1p1x, l1p1y);
+  __m256d d6 = direction_avx2(l2p1x, l2p1y, l2p2x, l2p2y, l1p2x, l1p2y);
+  __m256d d7 = direction_avx2(q1x, q1y, l2p1x, l2p1y, l1p1x, l1p1y);
+  __m256d d8 = direction_avx2(q1x, q1y, l2p1x, l2p1y, l1p2x, l1p2y);
+  __m256d d9 = direction_avx2(q2x, q2y, l2p2x, l2p2y, l1p1x, l1p1y);
+  __m256d d10 = direction_avx2(q2x, q2y, l2p2x, l2p2y, l1p2x, l1p2y);
+  __m256d d11 = direction_avx2(q1x, q1y, q2x, q2y, l1p1x, l1p1y);
+  __m256d d12 = direction_avx2(q1x, q1y, q2x, q2y, l1p2x, l1p2y);
+
+  m.already = PRODUCT_MASK_AVX2(d1, d2, _CMP_LE_OQ)
+      & PRODUCT_MASK_AVX2(d5, d6, _CMP_LE_OQ);
+  m.top = PRODUCT_MASK_AVX2(d3, d1, _CMP_LE_OQ)
+      & PRODUCT_MASK_AVX2(d7, d8, _CMP_LE_OQ);
+  m.bottom = PRODUCT_MASK_AVX2(d4, d2, _CMP_LE_OQ)
+      & PRODUCT_MASK_AVX2(d9, d10, _CMP_LE_OQ);
+  m.third = PRODUCT_MASK_AVX2(d3, d4, _CMP_LE_OQ)
+      & PRODUCT_MASK_AVX2(d11, d12, _CMP_LE_OQ);
+  m.parallelogram = PRODUCT_MASK_AVX2(d5, d11, _CMP_LT_OQ)
+      & PRODUCT_MASK_AVX2(d7, d9, _CMP_LT_OQ)
+      & PRODUCT_MASK_AVX2(d6, d12, _CMP_LT_OQ)
+      & PRODUCT_MASK_AVX2(d8, d10, _CMP_LT_OQ);
+
+  return resolveLanes(lines, l, candidates, lanes, m, types);
+}
+
+AVX2_TARGET
+static unsigned int intersectBatch_avx2(const LineStore* lines,
+                                        unsigned int l,
+                                        const unsigned int* candidates,
+                                        unsigned int count,
+                                        IntersectionType* types) {
+  unsigned int hits = 0;
+  unsigned int k = 0;
+  for (; k + 4 <= count; k += 4) {
+    hits |= intersect4_avx2(lines, l, candidates + k, 4, types + k) << k;
+  }
+  if (k < count) {
+    // Pad the last group by repeating its final candidate.
+    unsigned int padded[4];
+    unsigned int lanes = count - k;
+    for (unsigned int j = 0; j < 4; j++) {
+      padded[j] = candidates[k + MIN(j, lanes - 1)];
+    }
+    hits |= intersect4_avx2(lines, l, padded, lanes, types + k) << k;
+  }
+  return hits;
+}
+
+// ******************************** AVX-512 *********************************
+
+// direction() on eight lanes.
+AVX512_TARGET
+static inline __m512d direction_avx512(__m512d pix, __m512d piy,
+                                       __m512d pjx, __m512d pjy,
+                                       __m512d pkx, __m512d pky) {
+  return _mm512_sub_pd(
+      _mm512_mul_pd(_mm512_sub_pd(pkx, pix), _mm512_sub_pd(pjy, piy)),
+      _mm512_mul_pd(_mm512_sub_pd(pky, piy), _mm512_sub_pd(pjx, pix)));
+}
+
+// Mask of the lanes where a * b compares to zero with the predicate cmp.
+#define PRODUCT_MASK_AVX512(a, b, cmp)                                 \
+  ((unsigned int) _mm512_cmp_pd_mask(_mm512_mul_pd((a), (b)),          \
+                                     _mm512_setzero_pd(), (cmp)))
+
+// Tests line l against the eight candidates; only the first lanes results
+// are kept.
+AVX512_TARGET
+static unsigned int intersect8_avx512(const LineStore* lines, unsigned int l,
+                                      const unsigned int* candidates,
+                                      unsigned int lanes,
+                                      IntersectionType* types) {
+  const double* p1 = (const double*) lines->p1;
+  const double* p2 = (const double*) lines->p2;
+  const double* velocity = (const double*) lines->velocity;
+  const double* top_left = (const double*) lines->top_left;
+  const double* bottom_right = (const double*) lines->bottom_right;
+  unsigned int laneMask = (1u << lanes) - 1;
+
+  // Gather the candidates' bounding boxes and velocities.  Each Vec is two
+  // doubles, so the x coordinate of line i is double 2 * i.
+  __m256i ids = _mm256_loadu_si256((const __m256i*) candidates);
+  __m256i xs = _mm256_slli_epi32(ids, 1);
+  __m512d cvx = _mm512_i32gather_pd(xs, velocity, 8);
+  __m512d cvy = _mm512_i32gather_pd(xs, velocity + 1, 8);
+  __m512d ctlx = _mm512_i32gather_pd(xs, top_left, 8);
+  __m512d ctly = _mm512_i32gather_pd(xs, top_left + 1, 8);
+  __m512d cbrx = _mm512_i32gather_pd(xs, bottom_right, 8);
+  __m512d cbry = _mm512_i32gather_pd(xs, bottom_right + 1, 8);
+
+  // Test the swept boxes as sweptBoxesOverlap() does.  _mm512_min_pd and
+  // _mm512_max_pd select exactly like the MIN and MAX macros.
+  Vec tl = lines->top_left[l];
+  Vec br = lines->bottom_right[l];
+  Vec v = lines->velocity[l];
+  __m512d loX = _mm512_set1_pd(MIN(tl.x, tl.x + v.x));
+  __m512d loY = _mm512_set1_pd(MIN(tl.y, tl.y + v.y));
+  __m512d hiX = _mm512_set1_pd(MAX(br.x, br.x + v.x));
+  __m512d hiY = _mm512_set1_pd(MAX(br.y, br.y + v.y));
+  __m512d cLoX = _mm512_min_pd(ctlx, _mm512_add_pd(ctlx, cvx));
+  __m512d cLoY = _mm512_min_pd(ctly, _mm512_add_pd(ctly, cvy));
+  __m512d cHiX = _mm512_max_pd(cbrx, _mm512_add_pd(cbrx, cvx));
+  __m512d cHiY = _mm512_max_pd(cbry, _mm512_add_pd(cbry, cvy));
+  unsigned int overlap = _mm512_cmp_pd_mask(loX, cHiX, _CMP_LE_OQ)
+      & _mm512_cmp_pd_mask(cLoX, hiX, _CMP_LE_OQ)
+      & _mm512_cmp_pd_mask(loY, cHiY, _CMP_LE_OQ)
+      & _mm512_cmp_pd_mask(cLoY, hiY, _CMP_LE_OQ);
+  unsigned int disjoint = ~overlap & 0xFF;
+  if ((disjoint & laneMask) == laneMask) {
+    for (unsigned int k = 0; k < lanes; k++) {
+      types[k] = NO_INTERSECTION;
+    }
+    return 0;
+  }
+
+  // Gather the candidates' endpoints.
+  __m512d c1x = _mm512_i32gather_pd(xs, p1, 8);
+  __m512d c1y = _mm512_i32gather_pd(xs, p1 + 1, 8);
+  __m512d c2x = _mm512_i32gather_pd(xs, p2, 8);
+  __m512d c2y = _mm512_i32gather_pd(xs, p2 + 1, 8);
+
+  __m512d a1x = _mm512_set1_pd(lines->p1[l].x);
+  __m512d a1y = _mm512_set1_pd(lines->p1[l].y);
+  __m512d a2x = _mm512_set1_pd(lines->p2[l].x);
+  __m512d a2y = _mm512_set1_pd(lines->p2[l].y);
+  __m512d avx = _mm512_set1_pd(lines->velocity[l].x);
+  __m512d avy = _mm512_set1_pd(lines->velocity[l].y);
+
+  // In lanes where the candidate's ID is below l's, the candidate plays the
+  // role of l1.
+  __mmask8 swap = 0;
+  for (unsigned int k = 0; k < 8; k++) {
+    swap |= (candidates[k] < l) << k;
+  }
+
+  __m512d l1p1x = _mm512_mask_blend_pd(swap, a1x, c1x);
+  __m512d l1p1y = _mm512_mask_blend_pd(swap, a1y, c1y);
+  __m512d l1p2x = _mm512_mask_blend_pd(swap, a2x, c2x);
+  __m512d l1p2y = _mm512_mask_blend_pd(swap, a2y, c2y);
+  __m512d l1vx = _mm512_mask_blend_pd(swap, avx, cvx);
+  __m512d l1vy = _mm512_mask_blend_pd(swap, avy, cvy);
+  __m512d l2p1x = _mm512_mask_blend_pd(swap, c1x, a1x);
+  __m512d l2p1y = _mm512_mask_blend_pd(swap, c1y, a1y);
+  __m512d l2p2x = _mm512_mask_blend_pd(swap, c2x, a2x);
+  __m512d l2p2y = _mm512_mask_blend_pd(swap, c2y, a2y);
+  __m512d l2vx = _mm512_mask_blend_pd(swap, cvx, avx);
+  __m512d l2vy = _mm512_mask_blend_pd(swap, cvy, avy);
+
+  // Get relative velocity.
+  __m512d half = _mm512_set1_pd(0.5);
+  __m512d dx = _mm512_mul_pd(_mm512_sub_pd(l2vx, l1vx), half);
+  __m512d dy = _mm512_mul_pd(_mm512_sub_pd(l2vy, l1vy), half);
+
+  // Get the parallelogram.
+  __m512d q1x = _mm512_add_pd(l2p1x, dx);
+  __m512d q1y = _mm512_add_pd(l2p1y, dy);
+  __m512d q2x = _mm512_add_pd(l2p2x, dx);
+  __m512d q2y = _mm512_add_pd(l2p2y, dy);
+
+  __m512d d1 = direction_avx512(l1p1x, l1p1y, l1p2x, l1p2y, l2p1x, l2p1y);
+  __m512d d2 = direction_avx512(l1p1x, l1p1y, l1p2x, l1p2y, l2p2x, l2p2y);
+  __m512d d3 = direction_avx512(l1p1x, l1p1y, l1p2x, l1p2y, q1x, q1y);
+  __m512d d4 = direction_avx512(l1p1x, l1p1y, l1p2x, l1p2y, q2x, q2y);
+
+  LaneMasks m;
+  m.reject = disjoint | (PRODUCT_MASK_AVX512(d1, d2, _CMP_GT_OQ)
+      & PRODUCT_MASK_AVX512(d2, d3, _CMP_GT_OQ)
+      & PRODUCT_MASK_AVX512(d3, d4, _CMP_GT_OQ));
+  if ((m.reject & laneMask) == laneMask) {
+    for (unsigned int k = 0; k < lanes; k++) {
+      types[k] = NO_INTERSECTION;
+    }
+    return 0;
+  }
+
+  __m512d d5 = direction_avx512(l2p1x, l2p1y, l2p2x, l2p2y, l1p1x, l1p1y);
+  __m512d d6 = direction_avx512(l2p1x, l2p1y, l2p2x, l2p2y, l1p2x, l1p2y);
+  __m512d d7 = direction_avx512(q1x, q1y, l2p1x, l2p1y, l1p1x, l1p1y);
+  __m512d d8 = direction_avx512(q1x, q1y, l2p1x, l2p1y, l1p2x, l1p2y);
+  __m512d d9 = direction_avx512(q2x, q2y, l2p2x, l2p2y, l1p1x, l1p1y);
+  __m512d d10 = direction_avx512(q2x, q2y, l2p2x, l2p2y, l1p2x, l1p2y);
+  __m512d d11 = direction_avx512(q1x, q1y, q2x, q2y, l1p1x, l1p1y);
+  __m512d d12 = direction_avx512(q1x, q1y, q2x, q2y, l1p2x, l1p2y);
+
+  m.already = PRODUCT_MASK_AVX512(d1, d2, _CMP_LE_OQ)
+      & PRODUCT_MASK_AVX512(d5, d6, _CMP_LE_OQ);
+  m.top = PRODUCT_MASK_AVX512(d3, d1, _CMP_LE_OQ)
+      & PRODUCT_MASK_AVX512(d7, d8, _CMP_LE_OQ);
+  m.bottom = PRODUCT_MASK_AVX512(d4, d2, _CMP_LE_OQ)
+      & PRODUCT_MASK_AVX512(d9, d10, _CMP_LE_OQ);
+  m.third = PRODUCT_MASK_AVX512(d3, d4, _CMP_LE_OQ)
+      & PRODUCT_MASK_AVX512(d11, d12, _CMP_LE_OQ);
+  m.parallelogram = PRODUCT_MASK_AVX512(d5, d11, _CMP_LT_OQ)
+      & PRODUCT_MASK_AVX512(d7, d9, _CMP_LT_OQ)
+      & PRODUCT_MASK_AVX512(d6, d12, _CMP_LT_OQ)
+      & PRODUCT_MASK_AVX512(d8, d10, _CMP_LT_OQ);
+
+  return resolveLanes(lines, l, candidates, lanes, m, types);
+}
+
+AVX512_TARGET
+static unsigned int intersectBatch_avx512(const LineStore* lines,
+                                          unsigned int l,
+                                          const unsigned int* candidates,
+                                          unsigned int count,
+                                          IntersectionType* types) {
+  if (count == 8) {
+    return intersect8_avx512(lines, l, candidates, 8, types);
+  }
+  if (count == 0) {
+    return 0;
+  }
+  // Pad a partial group by repeating its final candidate.
+  unsigned int padded[8];
+  for (unsigned int j = 0; j < 8; j++) {
+    padded[j] = candidates[MIN(j, count - 1)];
+  }
+  return intersect8_avx512(lines, l, padded, count, types);
+}
+
+#endif  // INTERSECT_HAVE_X86
+
+// ******************************* Dispatch *********************************
+
+static unsigned int intersectBatch_resolve(const LineStore* lines,
+                                           unsigned int l,
+                                           const unsigned int* candidates,
+                                           unsigned int count,
+                                           IntersectionType* types);
+
+static IntersectBatchKernel intersectBatch_kernel = intersectBatch_resolve;
+static const char* intersectBatch_name = "scalar";
+
+// Picks the widest kernel the CPU supports and INTERSECT_ISA allows.
+static void intersectBatch_select() {
+  IntersectBatchKernel kernel = intersectBatch_scalar;
+  const char* name = "scalar";
+#ifdef INTERSECT_HAVE_X86
+  const char* isa = getenv("INTERSECT_ISA");
+  bool allowAvx512 = isa == NULL || strcmp(isa, "avx512") == 0;
+  bool allowAvx2 = allowAvx512 || strcmp(isa, "avx2") == 0;
+  __builtin_cpu_init();
+  if (allowAvx512 && __builtin_cpu_supports("avx512f")) {
+    kernel = intersectBatch_avx512;
+    name = "avx512";
+  } else if (allowAvx2 && __builtin_cpu_supports("avx2")) {
+    kernel = intersectBatch_avx2;
+    name = "avx2";
+  }
+#endif
+  intersectBatch_name = name;
+  intersectBatch_kernel = kernel;
+}
+
+// Initial value of intersectBatch_kernel: selects the real kernel, then
+// forwards the call to it.
+static unsigned int intersectBatch_resolve(const LineStore* lines,
+                                           unsigned int l,
+                                           const unsigned int* candidates,
+                                           unsigned int count,
+                                           IntersectionType* types) {
+  intersectBatch_select();
+  return intersectBatch_kernel(lines, l, candidates, count, types);
+}
+
+void intersectBatch_init() {
+  intersectBatch_select();
+}
+
+const char* intersectBatch_kernelName() {
+  if (intersectBatch_kernel == intersectBatch_resolve) {
+    intersectBatch_select();
+  }
+  return intersectBatch_name;
+}
+
+unsigned int intersectBatch(const LineStore* lines, unsigned int l,
+                            const unsigned int* candidates,
+                            unsigned int count, IntersectionType* types) {
+  assert(count <= INTERSECT_BATCH_SIZE);
+
+  unsigned int hits = intersectBatch_kernel(lines, l, candidates, count,
+                                            types);
+  STATS_COUNT_TESTS(lines, l, candidates, count, types);
+
+#ifndef NDEBUG
+  // The vector kernels must agree exactly with the scalar one.
+  for (unsigned int k = 0; k < count; k++) {
+    assert(types[k] == intersectOrdered(lines, l, candidates[k]));
+    assert(((hits >> k) & 1) == (types[k] != NO_INTERSECTION));
+  }
+#endif
+
+  return hits;
+}
@@ -0,0 +1,54 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Batched line-line intersection tests: one line against several candidates.
+#ifndef INTERSECTIONBATCH_H_
+#define INTERSECTIONBATCH_H_
+
+#include "./Line.h"
+#include "./IntersectionDetection.h"
+
+// Maximum number of candidates tested by one call to intersectBatch.
+#define INTERSECT_BATCH_SIZE 8
+
+// Tests line l against each of the count lines in candidates.  For every k,
+// the pair is ordered by ID as for intersect(), so types[k] is set to
+// intersect(lines, MIN(l, candidates[k]), MAX(l, candidates[k])).
+// Returns a mask with bit k set iff types[k] != NO_INTERSECTION.
+//
+// The kernel is chosen at the first call from the best instruction set the
+// CPU supports (AVX-512, AVX2, or scalar).  Setting the environment variable
+// INTERSECT_ISA to "avx512", "avx2" or "scalar" restricts the choice.
+//
+// Precondition: count <= INTERSECT_BATCH_SIZE and no candidate equals l.
+unsigned int intersectBatch(const LineStore* lines, unsigned int l,
+                            const unsigned int* candidates,
+                            unsigned int count, IntersectionType* types);
+
+// Selects the kernel intersectBatch uses.  Called once at startup so that
+// the choice is not made concurrently by several workers.
+void intersectBatch_init();
+
+// Returns the name of the kernel intersectBatch uses.
+const char* intersectBatch_kernelName();
+
+#endif  // INTERSECTIONBATCH_H_
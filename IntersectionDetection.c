@@ -23,39 +23,52 @@
 #include "./IntersectionDetection.h"
 
 // Detect if lines l1 and l2 will intersect between now and the next time step.
-IntersectionType intersect(Line *l1, Line *l2) {
-  assert(compareLines(l1, l2) < 0);
+IntersectionType intersect(const LineStore* lines, unsigned int l1,
+                           unsigned int l2) {
+  assert(l1 < l2);
+
+  // Pairs whose swept boxes are disjoint cannot meet.  Without this test,
+  // far-apart collinear pairs, for which every direction() below is zero,
+  // would be reported as ALREADY_INTERSECTED.
+  if (!sweptBoxesOverlap(lines, l1, l2)) {
+    return NO_INTERSECTION;
+  }
+
+  Vec l1p1 = lines->p1[l1];
+  Vec l1p2 = lines->p2[l1];
+  Vec l2p1 = lines->p1[l2];
+  Vec l2p2 = lines->p2[l2];
 
   // Get relative velocity.
-  double dx = (l2->velocity.x - l1->velocity.x) * 0.5;
-  double dy = (l2->velocity.y - l1->velocity.y) * 0.5;
+  double dx = (lines->velocity[l2].x - lines->velocity[l1].x) * 0.5;
+  double dy = (lines->velocity[l2].y - lines->velocity[l1].y) * 0.5;
 
   // Get the parallelogram.
-  Vec p1 = {.x = l2->p1.x + dx, .y = l2->p1.y + dy};
-  Vec p2 = {.x = l2->p2.x + dx, .y = l2->p2.y + dy};
+  Vec p1 = {.x = l2p1.x + dx, .y = l2p1.y + dy};
+  Vec p2 = {.x = l2p2.x + dx, .y = l2p2.y + dy};
 
-  double d1 = direction(l1->p1, l1->p2, l2->p1);
-  double d2 = direction(l1->p1, l1->p2, l2->p2);
-  double d3 = direction(l1->p1, l1->p2, p1);
-  double d4 = direction(l1->p1, l1->p2, p2);
+  double d1 = direction(l1p1, l1p2, l2p1);
+  double d2 = direction(l1p1, l1p2, l2p2);
+  double d3 = direction(l1p1, l1p2, p1);
+  double d4 = direction(l1p1, l1p2, p2);
 
   if ((d1 * d2 > 0) && (d2 * d3 > 0) && (d3 * d4 > 0)) {
     return NO_INTERSECTION;
   }
 
-  double d5 = direction(l2->p1, l2->p2, l1->p1);
-  double d6 = direction(l2->p1, l2->p2, l1->p2);
+  double d5 = direction(l2p1, l2p2, l1p1);
+  double d6 = direction(l2p1, l2p2, l1p2);
 
   if (intersectLines(d1*d2, d5*d6)) {
     return ALREADY_INTERSECTED;
   }
 
-  double d7 = direction(p1, l2->p1, l1->p1);
-  double d8 = direction(p1, l2->p1, l1->p2);
-  double d9 = direction(p2, l2->p2, l1->p1);
-  double d10 = direction(p2, l2->p2, l1->p2);
-  double d11 = direction(p1, p2, l1->p1);
-  double d12 = direction(p1, p2, l1->p2);
+  double d7 = direction(p1, l2p1, l1p1);
+  double d8 = direction(p1, l2p1, l1p2);
+  double d9 = direction(p2, l2p2, l1p1);
+  double d10 = direction(p2, l2p2, l1p2);
+  double d11 = direction(p1, p2, l1p1);
+  double d12 = direction(p1, p2, l1p2);
 
   bool top_intersected = intersectLines(d3*d1, d7*d8);
   bool bottom_intersected = intersectLines(d4*d2, d9*d10);
@@ -74,7 +87,9 @@ IntersectionType intersect(Line *l1, Line *l2) {
     return NO_INTERSECTION;
   }
 
-  double angle = atan2(l1->relative_vector.y, l1->relative_vector.x) - atan2(l2->relative_vector.y, l2->relative_vector.x);
+  Vec r1 = lines->relative_vector[l1];
+  Vec r2 = lines->relative_vector[l2];
+  double angle = atan2(r1.y, r1.x) - atan2(r2.y, r2.x);
 
   if ((top_intersected && (angle < 0)) || (bottom_intersected && (angle > 0))) {
     return L2_WITH_L1;
@@ -38,9 +38,31 @@ typedef enum {
   ALREADY_INTERSECTED
 } IntersectionType;
 
-// Detect if line l1 and l2 will be intersected in the next time step.
-// Precondition: compareLines(l1, l2) < 0 must be true.
-IntersectionType intersect(Line *l1, Line *l2);
+// Check if the bounding boxes of lines l1 and l2, each swept over one full
+// velocity step, overlap.  Lines whose swept boxes are disjoint cannot meet
+// during the next time step.  The boxes are the ones the quadtree's can_fit
+// tests against its (half-open) node bounds, so two lines held in disjoint
+// nodes never pass this check.
+static inline bool sweptBoxesOverlap(const LineStore* lines, unsigned int l1,
+                                     unsigned int l2) {
+  Vec tl1 = lines->top_left[l1];
+  Vec br1 = lines->bottom_right[l1];
+  Vec v1 = lines->velocity[l1];
+  Vec tl2 = lines->top_left[l2];
+  Vec br2 = lines->bottom_right[l2];
+  Vec v2 = lines->velocity[l2];
+  return MIN(tl1.x, tl1.x + v1.x) <= MAX(br2.x, br2.x + v2.x)
+      && MIN(tl2.x, tl2.x + v2.x) <= MAX(br1.x, br1.x + v1.x)
+      && MIN(tl1.y, tl1.y + v1.y) <= MAX(br2.y, br2.y + v2.y)
+      && MIN(tl2.y, tl2.y + v2.y) <= MAX(br1.y, br1.y + v1.y);
+}
+
+// Detect if lines l1 and l2 of the store will be intersected in the next
+// time step.  Lines whose swept boxes are disjoint never intersect, so the
+// result does not depend on which pairs a broad phase chooses to test.
+// Precondition: l1 < l2 must be true.
+IntersectionType intersect(const LineStore* lines, unsigned int l1,
+                           unsigned int l2);
 
 // Check if a point is in the parallelogram.
 bool pointInParallelogram(double d1, double d2);
@@ -22,84 +22,131 @@
 
 #include "./IntersectionEventList.h"
 
-int IntersectionEventNode_compareData(IntersectionEventNode* node1,
-                                      IntersectionEventNode* node2) {
-  if (compareLines(node1->l1, node2->l1) < 0) {
-    return -1;
-  } else if (compareLines(node1->l1, node2->l1) == 0) {
-    if (compareLines(node1->l2, node2->l2) < 0) {
-      return -1;
-    } else if (compareLines(node1->l2, node2->l2) == 0) {
-      return 0;
-    } else {
-      return 1;
-    }
-  } else {
-    return 1;
+#include <string.h>
+
+#include "./Parallel.h"
+
+// Events each buffer has room for when first made
+#define INITIAL_BUFFER_CAPACITY 64
+
+IntersectionEventList IntersectionEventList_make() {
+  IntersectionEventList intersectionEventList;
+  intersectionEventList.numBuffers = Parallel_getNumWorkers();
+  int error = posix_memalign(
+      (void**) &intersectionEventList.buffers, sizeof(IntersectionEventBuffer),
+      sizeof(IntersectionEventBuffer) * intersectionEventList.numBuffers);
+  assert(error == 0);
+  (void) error;
+  for (unsigned int i = 0; i < intersectionEventList.numBuffers; i++) {
+    IntersectionEventBuffer* buffer = &intersectionEventList.buffers[i];
+    buffer->size = 0;
+    buffer->capacity = INITIAL_BUFFER_CAPACITY;
+    buffer->events = malloc(sizeof(IntersectionEvent) * buffer->capacity);
+    assert(buffer->events != NULL);
+    buffer->numMallocs = 1;
   }
+  return intersectionEventList;
 }
 
-void IntersectionEventNode_swapData(IntersectionEventNode* node1,
-                                    IntersectionEventNode* node2) {
-  {
-    Line* temp = node1->l1;
-    node1->l1 = node2->l1;
-    node2->l1 = temp;
-  }
-  {
-    Line* temp = node1->l2;
-    node1->l2 = node2->l2;
-    node2->l2 = temp;
+void IntersectionEventList_destroy(
+    IntersectionEventList* intersectionEventList) {
+  for (unsigned int i = 0; i < intersectionEventList->numBuffers; i++) {
+    free(intersectionEventList->buffers[i].events);
   }
-  {
-    IntersectionType temp = node1->intersectionType;
-    node1->intersectionType = node2->intersectionType;
-    node2->intersectionType = temp;
+  free(intersectionEventList->buffers);
+  intersectionEventList->buffers = NULL;
+  intersectionEventList->numBuffers = 0;
+}
+
+void IntersectionEventList_clear(IntersectionEventList* intersectionEventList) {
+  for (unsigned int i = 0; i < intersectionEventList->numBuffers; i++) {
+    intersectionEventList->buffers[i].size = 0;
   }
 }
 
-IntersectionEventList IntersectionEventList_make() {
-  IntersectionEventList intersectionEventList;
-  intersectionEventList.head = NULL;
-  intersectionEventList.tail = NULL;
-  intersectionEventList.size = 0;
-  return intersectionEventList;
+void IntersectionEventList_append(
+    IntersectionEventList* intersectionEventList, unsigned int l1,
+    unsigned int l2, IntersectionType intersectionType) {
+  assert(l1 < l2);
+
+  unsigned int worker = Parallel_getWorkerId();
+  assert(worker < intersectionEventList->numBuffers);
+  IntersectionEventBuffer* buffer = &intersectionEventList->buffers[worker];
+
+  // double the buffer's capacity if full
+  if (buffer->size == buffer->capacity) {
+    buffer->capacity *= 2;
+    buffer->events = realloc(buffer->events,
+                             sizeof(IntersectionEvent) * buffer->capacity);
+    assert(buffer->events != NULL);
+    buffer->numMallocs++;
+  }
+
+  IntersectionEvent* event = &buffer->events[buffer->size++];
+  event->l1 = l1;
+  event->l2 = l2;
+  event->intersectionType = intersectionType;
 }
 
-void IntersectionEventList_appendNode(
-    IntersectionEventList* intersectionEventList, Line* l1, Line* l2,
-    IntersectionType intersectionType) {
-  assert(compareLines(l1, l2) < 0);
+void IntersectionEventList_appendHits(
+    IntersectionEventList* intersectionEventList, unsigned int l,
+    const unsigned int* candidates, unsigned int hits,
+    const IntersectionType* types) {
+  while (hits) {
+    int k = __builtin_ctz(hits);
+    hits &= hits - 1;
+    unsigned int candidate = candidates[k];
+    IntersectionEventList_append(intersectionEventList, MIN(l, candidate),
+                                 MAX(l, candidate), types[k]);
+  }
+}
 
-  IntersectionEventNode* newNode = malloc(sizeof(IntersectionEventNode));
-  if (newNode == NULL) {
-    return;
+unsigned int IntersectionEventList_size(
+    const IntersectionEventList* intersectionEventList) {
+  unsigned int size = 0;
+  for (unsigned int i = 0; i < intersectionEventList->numBuffers; i++) {
+    size += intersectionEventList->buffers[i].size;
   }
+  return size;
+}
 
-  newNode->l1 = l1;
-  newNode->l2 = l2;
-  newNode->intersectionType = intersectionType;
-  newNode->next = NULL;
-  if (intersectionEventList->head == NULL) {
-    intersectionEventList->head = newNode;
-  } else {
-    intersectionEventList->tail->next = newNode;
+unsigned long IntersectionEventList_getNumMallocs(
+    const IntersectionEventList* intersectionEventList) {
+  // the buffers array itself, then each buffer's events
+  unsigned long numMallocs = 1;
+  for (unsigned int i = 0; i < intersectionEventList->numBuffers; i++) {
+    numMallocs += intersectionEventList->buffers[i].numMallocs;
   }
-  intersectionEventList->tail = newNode;
+  return numMallocs;
+}
 
-  intersectionEventList->size++;
+typedef struct {
+  const IntersectionEventList* list;
+  const unsigned int* offsets;
+  IntersectionEvent* events;
+} ToArrayContext;
+
+static void copy_buffers(void* context, unsigned int begin, unsigned int end) {
+  ToArrayContext* c = context;
+  for (unsigned int i = begin; i < end; i++) {
+    const IntersectionEventBuffer* buffer = &c->list->buffers[i];
+    memcpy(&c->events[c->offsets[i]], buffer->events,
+           sizeof(IntersectionEvent) * buffer->size);
+  }
 }
 
-void IntersectionEventList_deleteNodes(
-    IntersectionEventList* intersectionEventList) {
-  IntersectionEventNode* curNode = intersectionEventList->head;
-  IntersectionEventNode* nextNode = NULL;
-  while (curNode != NULL) {
-    nextNode = curNode->next;
-    free(curNode);
-    curNode = nextNode;
+void IntersectionEventList_toArray(
+    const IntersectionEventList* intersectionEventList,
+    IntersectionEvent* events) {
+  unsigned int numBuffers = intersectionEventList->numBuffers;
+  unsigned int offsets[numBuffers];
+  unsigned int offset = 0;
+  for (unsigned int i = 0; i < numBuffers; i++) {
+    offsets[i] = offset;
+    offset += intersectionEventList->buffers[i].size;
   }
-  intersectionEventList->head = NULL;
-  intersectionEventList->tail = NULL;
-  intersectionEventList->size = 0;
+  ToArrayContext context = {
+    .list = intersectionEventList, .offsets = offsets, .events = events
+  };
+  Parallel_for(numBuffers, 1, copy_buffers, &context);
 }
@@ -24,48 +24,79 @@
 #define INTERSECTIONEVENTLIST_H_
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include "./Line.h"
 #include "./IntersectionDetection.h"
 
-struct IntersectionEventNode {
-  // This IntersectionEventNode does not own these Line* lines.
-  Line* l1;
-  Line* l2;
-  IntersectionType intersectionType;
-  struct IntersectionEventNode* next;
+// An intersection event in flat form, for sorting and solving.
+struct IntersectionEvent {
+  // IDs of the two lines involved, with l1 < l2.
+  uint32_t l1;
+  uint32_t l2;
+  // An IntersectionType.
+  uint8_t intersectionType;
 };
-typedef struct IntersectionEventNode IntersectionEventNode;
+typedef struct IntersectionEvent IntersectionEvent;
 
-// Compares the nodes by l1's line ID, then l1's line ID.
-// -1 <=> node1 ordered before node2
-//  0 <=> node1 ordered the same as node2
-//  1 <=> node1 ordered after node2
-int IntersectionEventNode_compareData(IntersectionEventNode* node1,
-                                      IntersectionEventNode* node2);
-
-// Swaps the node1's and node2's data (l1, l2, intersectionType).
-void IntersectionEventNode_swapData(IntersectionEventNode* node1,
-                                    IntersectionEventNode* node2);
+// Events appended by one worker.  Padded to a cache line so that workers
+// appending at the same time do not share one.
+struct IntersectionEventBuffer {
+  IntersectionEvent* events;
+  unsigned int size;
+  unsigned int capacity;
+  // calls to malloc and realloc made for events
+  unsigned int numMallocs;
+} __attribute__((aligned(64)));
+typedef struct IntersectionEventBuffer IntersectionEventBuffer;
 
+// The events found in one frame, kept as one growable array per worker so
+// that appending needs neither locking nor, once the arrays have grown to
+// a frame's worth of events, malloc.  The arrays are reused across frames.
 struct IntersectionEventList {
-  IntersectionEventNode* head;
-  IntersectionEventNode* tail;
-  unsigned int size;
+  IntersectionEventBuffer* buffers;
+  unsigned int numBuffers;
 };
 typedef struct IntersectionEventList IntersectionEventList;
 
-// Returns an empty list.
+// Returns an empty list with one buffer per worker.
 IntersectionEventList IntersectionEventList_make();
 
-// Appends a new node to the list with the data (l1, l2, intersectionType).
-// Precondition: compareLines(l1, l2) < 0 must be true.
-void IntersectionEventList_appendNode(
-    IntersectionEventList* intersectionEventList, Line* l1, Line* l2,
-    IntersectionType intersectionType);
-
-// Deletes all the nodes in the list.
-void IntersectionEventList_deleteNodes(
+// Frees the list's buffers.
+void IntersectionEventList_destroy(
     IntersectionEventList* intersectionEventList);
 
+// Empties the list, keeping its buffers' memory.
+void IntersectionEventList_clear(IntersectionEventList* intersectionEventList);
+
+// Appends the event (l1, l2, intersectionType) to the calling worker's
+// buffer.
+// Precondition: l1 < l2 must be true.
+void IntersectionEventList_append(
+    IntersectionEventList* intersectionEventList, unsigned int l1,
+    unsigned int l2, IntersectionType intersectionType);
+
+// Appends an event for every k whose bit is set in hits, with the data
+// (MIN(l, candidates[k]), MAX(l, candidates[k]), types[k]).  Takes the
+// result of an intersectBatch call.
+void IntersectionEventList_appendHits(
+    IntersectionEventList* intersectionEventList, unsigned int l,
+    const unsigned int* candidates, unsigned int hits,
+    const IntersectionType* types);
+
+// Returns the number of events in the list.
+unsigned int IntersectionEventList_size(
+    const IntersectionEventList* intersectionEventList);
+
+// Returns the number of calls to malloc and realloc made by the list since
+// it was made.
+unsigned long IntersectionEventList_getNumMallocs(
+    const IntersectionEventList* intersectionEventList);
+
+// Concatenates every worker's events into events, which must have room for
+// the list's size.
+void IntersectionEventList_toArray(
+    const IntersectionEventList* intersectionEventList,
+    IntersectionEvent* events);
+
 #endif  // INTERSECTIONEVENTLIST_H_
@@ -0,0 +1,151 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "./IntersectionEventSort.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+#include "./Parallel.h"
+
+#define EVENT_SORT_BUCKETS (1 << EVENT_SORT_RADIX_BITS)
+
+// Packs (l1, l2) into one key that orders events like (l1, l2) does.  l2
+// takes the low lineBits bits.
+static inline uint64_t event_key(const IntersectionEvent* event,
+                                 unsigned int lineBits) {
+  return ((uint64_t) event->l1 << lineBits) | event->l2;
+}
+
+static inline unsigned int event_digit(const IntersectionEvent* event,
+                                       unsigned int lineBits,
+                                       unsigned int shift) {
+  return (event_key(event, lineBits) >> shift) & (EVENT_SORT_BUCKETS - 1);
+}
+
+// One pass of the sort: the n events of src, split into blocks of
+// blockSize, sorted into dst by the digit at shift.  counts is as in
+// IntersectionEvent_sort().
+typedef struct {
+  const IntersectionEvent* src;
+  IntersectionEvent* dst;
+  unsigned int n;
+  unsigned int blockSize;
+  unsigned int lineBits;
+  unsigned int shift;
+  unsigned int (*counts)[EVENT_SORT_BUCKETS];
+} SortPass;
+
+static void count_digits(void* context, unsigned int begin, unsigned int end) {
+  SortPass* pass = context;
+  for (unsigned int b = begin; b < end; b++) {
+    unsigned int* count = pass->counts[b];
+    for (unsigned int d = 0; d < EVENT_SORT_BUCKETS; d++) {
+      count[d] = 0;
+    }
+    unsigned int blockEnd = MIN(pass->n, (b + 1) * pass->blockSize);
+    for (unsigned int i = b * pass->blockSize; i < blockEnd; i++) {
+      count[event_digit(&pass->src[i], pass->lineBits, pass->shift)]++;
+    }
+  }
+}
+
+static void scatter_events(void* context, unsigned int begin,
+                           unsigned int end) {
+  SortPass* pass = context;
+  for (unsigned int b = begin; b < end; b++) {
+    unsigned int* next = pass->counts[b];
+    unsigned int blockEnd = MIN(pass->n, (b + 1) * pass->blockSize);
+    for (unsigned int i = b * pass->blockSize; i < blockEnd; i++) {
+      const IntersectionEvent* event = &pass->src[i];
+      pass->dst[next[event_digit(event, pass->lineBits, pass->shift)]++] =
+          *event;
+    }
+  }
+}
+
+IntersectionEvent* IntersectionEvent_sort(IntersectionEvent* events,
+                                          IntersectionEvent* scratch,
+                                          unsigned int n,
+                                          unsigned int numOfLines) {
+  // Only the bits that a line ID can occupy need sorting.
+  unsigned int lineBits = 1;
+  while (lineBits < 32 && (1u << lineBits) < numOfLines) {
+    lineBits++;
+  }
+  unsigned int keyBits = 2 * lineBits;
+
+  unsigned int numBlocks = n / EVENT_SORT_MIN_BLOCK;
+  numBlocks = MIN(numBlocks, 4 * Parallel_getNumWorkers());
+  numBlocks = MIN(numBlocks, EVENT_SORT_MAX_BLOCKS);
+  numBlocks = MAX(numBlocks, 1);
+  unsigned int blockSize = (n + numBlocks - 1) / numBlocks;
+
+  // counts[b][d] is first the number of events in block b with digit d, and
+  // then where block b's next such event goes.
+  unsigned int counts[EVENT_SORT_MAX_BLOCKS][EVENT_SORT_BUCKETS];
+
+  IntersectionEvent* src = events;
+  IntersectionEvent* dst = scratch;
+  for (unsigned int shift = 0; shift < keyBits;
+       shift += EVENT_SORT_RADIX_BITS) {
+    SortPass pass = {
+      .src = src, .dst = dst, .n = n, .blockSize = blockSize,
+      .lineBits = lineBits, .shift = shift, .counts = counts
+    };
+    Parallel_for(numBlocks, 1, count_digits, &pass);
+
+    // Lay the buckets out in digit order, and within a digit in block order,
+    // which keeps the sort stable.  A pass where every event has the same
+    // digit would not move anything, so it is skipped.
+    unsigned int offset = 0;
+    bool trivial = false;
+    for (unsigned int d = 0; d < EVENT_SORT_BUCKETS; d++) {
+      unsigned int start = offset;
+      for (unsigned int b = 0; b < numBlocks; b++) {
+        unsigned int count = counts[b][d];
+        counts[b][d] = offset;
+        offset += count;
+      }
+      if (offset - start == n) {
+        trivial = true;
+      }
+    }
+    assert(offset == n);
+    if (trivial) {
+      continue;
+    }
+
+    Parallel_for(numBlocks, 1, scatter_events, &pass);
+
+    IntersectionEvent* temp = src;
+    src = dst;
+    dst = temp;
+  }
+
+#ifndef NDEBUG
+  for (unsigned int i = 1; i < n; i++) {
+    assert(event_key(&src[i - 1], lineBits) < event_key(&src[i], lineBits));
+  }
+#endif
+  return src;
+}
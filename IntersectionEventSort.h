@@ -0,0 +1,46 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Parallel LSD radix sort of intersection events.
+#ifndef INTERSECTIONEVENTSORT_H_
+#define INTERSECTIONEVENTSORT_H_
+
+#include "./IntersectionEventList.h"
+
+// Bits of the key sorted by each pass
+#define EVENT_SORT_RADIX_BITS 8
+// Fewest events given to each block of a pass; smaller inputs use fewer
+// blocks so that the per-block histograms stay cheap
+#define EVENT_SORT_MIN_BLOCK 4096
+// Most blocks a pass is split into
+#define EVENT_SORT_MAX_BLOCKS 32
+
+// Sorts the n events by (l1, l2), the order the collision solver processes
+// them in.  Every line ID must be less than numOfLines.  scratch must have
+// room for n events.  The sorted events end up in either events or scratch;
+// the one holding them is returned.
+IntersectionEvent* IntersectionEvent_sort(IntersectionEvent* events,
+                                          IntersectionEvent* scratch,
+                                          unsigned int n,
+                                          unsigned int numOfLines);
+
+#endif  // INTERSECTIONEVENTSORT_H_
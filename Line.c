@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "./Line.h"
+
+// Allocates an array of count elements of the given size, aligned to
+// LINESTORE_ALIGNMENT bytes.
+static void* LineStore_allocArray(size_t count, size_t size) {
+  void* array = NULL;
+  if (posix_memalign(&array, LINESTORE_ALIGNMENT, count * size) != 0) {
+    return NULL;
+  }
+  return array;
+}
+
+LineStore LineStore_make(const unsigned int capacity) {
+  LineStore store;
+  store.p1 = LineStore_allocArray(capacity, sizeof(Vec));
+  store.p2 = LineStore_allocArray(capacity, sizeof(Vec));
+  store.velocity = LineStore_allocArray(capacity, sizeof(Vec));
+  store.relative_vector = LineStore_allocArray(capacity, sizeof(Vec));
+  store.top_left = LineStore_allocArray(capacity, sizeof(Vec));
+  store.bottom_right = LineStore_allocArray(capacity, sizeof(Vec));
+  store.color = LineStore_allocArray(capacity, sizeof(Color));
+  store.numOfLines = 0;
+  store.capacity = capacity;
+  store.mapping = NULL;
+  store.mappingSize = 0;
+  return store;
+}
+
+void LineStore_destroy(LineStore* store) {
+  if (store->mapping != NULL) {
+    munmap(store->mapping, store->mappingSize);
+    store->mapping = NULL;
+    store->mappingSize = 0;
+    store->numOfLines = 0;
+    store->capacity = 0;
+    return;
+  }
+  free(store->p1);
+  free(store->p2);
+  free(store->velocity);
+  free(store->relative_vector);
+  free(store->top_left);
+  free(store->bottom_right);
+  free(store->color);
+  store->numOfLines = 0;
+  store->capacity = 0;
+}
+
+void LineStore_addLine(LineStore* store, const Line* line) {
+  assert(store->numOfLines < store->capacity);
+  assert(line->id == store->numOfLines);
+
+  unsigned int i = store->numOfLines;
+  store->p1[i] = line->p1;
+  store->p2[i] = line->p2;
+  store->velocity[i] = line->velocity;
+  store->relative_vector[i] = line->relative_vector;
+  store->top_left[i] = line->top_left;
+  store->bottom_right[i] = line->bottom_right;
+  store->color[i] = line->color;
+  store->numOfLines++;
+}
+
+Line LineStore_getLine(const LineStore* store, const unsigned int index) {
+  assert(index < store->numOfLines);
+
+  Line line;
+  line.p1 = store->p1[index];
+  line.p2 = store->p2[index];
+  line.velocity = store->velocity[index];
+  line.color = store->color[index];
+  line.id = index;
+  line.relative_vector = store->relative_vector[index];
+  line.top_left = store->top_left[index];
+  line.bottom_right = store->bottom_right[index];
+  return line;
+}
@@ -24,6 +24,8 @@
 #ifndef LINE_H_
 #define LINE_H_
 
+#include <stddef.h>
+
 #include "./GraphicStuff.h"
 #include "./Vec.h"
 
@@ -67,6 +69,44 @@ struct Line {
 };
 typedef struct Line Line;
 
+// Arrays in a LineStore are aligned to this many bytes (one cache line).
+#define LINESTORE_ALIGNMENT 64
+
+// All lines in the simulation, stored as a structure of arrays.  The line
+// with ID i lives at index i of every array, so lines are referred to by
+// their ID everywhere outside of loading and drawing.
+struct LineStore {
+  Vec* p1;
+  Vec* p2;
+  Vec* velocity;
+  Vec* relative_vector;
+  Vec* top_left;
+  Vec* bottom_right;
+  Color* color;
+
+  unsigned int numOfLines;
+  unsigned int capacity;
+
+  // If not NULL, the arrays point into this private mapping of a scene
+  // file, and are released by unmapping it rather than freeing them.
+  void* mapping;
+  size_t mappingSize;
+};
+typedef struct LineStore LineStore;
+
+// Returns an empty store with room for capacity lines.
+LineStore LineStore_make(const unsigned int capacity);
+
+// Frees all the arrays in the store, or unmaps them if they were mapped.
+void LineStore_destroy(LineStore* store);
+
+// Copies line into the store at index line->id.
+// Precondition: line->id == store->numOfLines < store->capacity.
+void LineStore_addLine(LineStore* store, const Line* line);
+
+// Returns a copy of the line at the given index.
+Line LineStore_getLine(const LineStore* store, const unsigned int index);
+
 // Compares the lines by line ID.
 // -1 <=> line1 ordered before line2
 //  0 <=> line1 ordered the same as line2
@@ -29,6 +29,7 @@
 #include "./LineDemo.h"
 #include "./GraphicStuff.h"
 #include "./Line.h"
+#include "./SceneFile.h"
 
 static char* LineDemo_input_file_path;
 
@@ -53,52 +54,14 @@ void LineDemo_delete(LineDemo* lineDemo) {
   free(lineDemo);
 }
 
-// Read in lines from line.in and add them into collision world for simulation.
+// Read in lines from the input file, in either scene format, and make a
+// collision world to simulate them.
 void LineDemo_createLines(LineDemo* lineDemo) {
-  unsigned int lineId = 0;
-  unsigned int numOfLines;
-  window_dimension px1;
-  window_dimension py1;
-  window_dimension px2;
-  window_dimension py2;
-  window_dimension vx;
-  window_dimension vy;
-  int isGray;
-  FILE *fin;
-  fin = fopen(LineDemo_input_file_path, "r");
-  assert(fin != NULL);
-
-  fscanf(fin, "%d\n", &numOfLines);
-  lineDemo->collisionWorld = CollisionWorld_new(numOfLines);
-
-  while (EOF
-      != fscanf(fin, "(%lf, %lf), (%lf, %lf), %lf, %lf, %d\n", &px1, &py1, &px2,
-                &py2, &vx, &vy, &isGray)) {
-    Line *line = malloc(sizeof(Line));
-
-    // convert window coordinates to box coordinates
-    windowToBox(&line->p1.x, &line->p1.y, px1, py1);
-    windowToBox(&line->p2.x, &line->p2.y, px2, py2);
-
-    // convert window velocity to box velocity
-    velocityWindowToBox(&line->velocity.x, &line->velocity.y, vx, vy);
-
-    // store color
-    line->color = (Color) isGray;
-
-    // store line ID
-    line->id = lineId;
-    lineId++;
-
-    // precompute some information about the line
-    line->relative_vector = Vec_makeFromLine(*line);
-    line->top_left = (Vec) {.x = MIN(line->p1.x, line->p2.x), .y = MIN(line->p1.y, line->p2.y)};
-    line->bottom_right = (Vec) {.x = MAX(line->p1.x, line->p2.x), .y = MAX(line->p1.y, line->p2.y)};
-
-    // transfer ownership of line to collisionWorld
-    CollisionWorld_addLine(lineDemo->collisionWorld, line);
+  LineStore lines;
+  if (!SceneFile_load(LineDemo_input_file_path, &lines)) {
+    exit(-1);
   }
-  fclose(fin);
+  lineDemo->collisionWorld = CollisionWorld_newWithLines(lines);
 }
 
 void LineDemo_setNumFrames(LineDemo* lineDemo, const unsigned int numFrames) {
@@ -109,7 +72,15 @@ void LineDemo_initLine(LineDemo* lineDemo) {
   LineDemo_createLines(lineDemo);
 }
 
-Line* LineDemo_getLine(LineDemo* lineDemo, const unsigned int index) {
+void LineDemo_setQuadtreeParams(LineDemo* lineDemo, QuadtreeParams params) {
+  CollisionWorld_setQuadtreeParams(lineDemo->collisionWorld, params);
+}
+
+void LineDemo_setBroadPhase(LineDemo* lineDemo, BroadPhaseType type) {
+  CollisionWorld_setBroadPhase(lineDemo->collisionWorld, type);
+}
+
+Line LineDemo_getLine(LineDemo* lineDemo, const unsigned int index) {
   return CollisionWorld_getLine(lineDemo->collisionWorld, index);
 }
 
@@ -125,6 +96,14 @@ unsigned int LineDemo_getNumLineLineCollisions(LineDemo* lineDemo) {
   return CollisionWorld_getNumLineLineCollisions(lineDemo->collisionWorld);
 }
 
+double LineDemo_getPairsTestedPerFrame(LineDemo* lineDemo) {
+  return CollisionWorld_getPairsTestedPerFrame(lineDemo->collisionWorld);
+}
+
+unsigned long LineDemo_getMallocsAfterFirstFrame(LineDemo* lineDemo) {
+  return CollisionWorld_getMallocsAfterFirstFrame(lineDemo->collisionWorld);
+}
+
 // The main simulation loop
 bool LineDemo_update(LineDemo* lineDemo) {
   lineDemo->count++;
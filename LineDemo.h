@@ -51,8 +51,16 @@ void LineDemo_setNumFrames(LineDemo* lineDemo, const unsigned int numFrames);
 // Initialize line simulation.
 void LineDemo_initLine(LineDemo* lineDemo);
 
-// Get ith line.
-Line* LineDemo_getLine(LineDemo* lineDemo, const unsigned int index);
+// Set the limits on the collision world's quadtree.  Must be called after
+// LineDemo_initLine.
+void LineDemo_setQuadtreeParams(LineDemo* lineDemo, QuadtreeParams params);
+
+// Select the collision world's broad-phase engine.  Must be called after
+// LineDemo_initLine.
+void LineDemo_setBroadPhase(LineDemo* lineDemo, BroadPhaseType type);
+
+// Get a copy of the ith line.
+Line LineDemo_getLine(LineDemo* lineDemo, const unsigned int index);
 
 // Get num of lines.
 unsigned int LineDemo_getNumOfLines(LineDemo* lineDemo);
@@ -63,6 +71,13 @@ unsigned int LineDemo_getNumLineWallCollisions(LineDemo* lineDemo);
 // Get number of line-line collisions.
 unsigned int LineDemo_getNumLineLineCollisions(LineDemo* lineDemo);
 
+// Get mean number of line pairs tested per frame.
+double LineDemo_getPairsTestedPerFrame(LineDemo* lineDemo);
+
+// Get number of times the memory frames use was allocated or grown after the
+// first frame.
+unsigned long LineDemo_getMallocsAfterFirstFrame(LineDemo* lineDemo);
+
 // Line simulation update function.
 bool LineDemo_update(LineDemo* lineDemo);
 
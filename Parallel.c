@@ -0,0 +1,430 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "./Parallel.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "./Trace.h"
+#include "./WorkSpan.h"
+
+#ifdef PARALLEL_OPENMP
+#include <omp.h>
+#endif
+#ifdef PARALLEL_PTHREADS
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Number of workers asked for, or 0 if none was
+static unsigned int requestedWorkers = 0;
+
+void Parallel_setNumWorkers(unsigned int workers) {
+  assert(workers > 0);
+  requestedWorkers = workers;
+}
+
+#ifndef PARALLEL_SERIAL
+// Number of workers, or 0 until it has first been asked for
+static unsigned int numWorkers = 0;
+
+unsigned int Parallel_getNumWorkers() {
+  if (numWorkers == 0) {
+    const char* env = getenv(PARALLEL_WORKERS_ENV);
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    if (requestedWorkers > 0) {
+      numWorkers = requestedWorkers;
+    } else if (env != NULL && atoi(env) > 0) {
+      numWorkers = atoi(env);
+    } else {
+      numWorkers = processors > 0 ? processors : 1;
+    }
+  }
+  return numWorkers;
+}
+#endif
+
+// Runs body over iterations [begin, end), recording the range in the trace.
+static inline void run_body(ParallelForBody body, void* context,
+                            unsigned int begin, unsigned int end) {
+  TRACE_START(timer);
+  body(context, begin, end);
+  TRACE_RANGE(timer, begin, end);
+}
+
+// A per-worker running total, padded to a cache line so that workers adding
+// at the same time do not share one
+typedef struct {
+  unsigned long value;
+} __attribute__((aligned(64))) SumSlot;
+
+typedef struct {
+  ParallelSumBody body;
+  void* context;
+  SumSlot* slots;
+} SumContext;
+
+static void sum_range(void* context, unsigned int begin, unsigned int end) {
+  SumContext* sum = context;
+  unsigned long value = sum->body(sum->context, begin, end);
+  sum->slots[Parallel_getWorkerId()].value += value;
+}
+
+unsigned long Parallel_sum(unsigned int n, unsigned int grain,
+                           ParallelSumBody body, void* context) {
+  unsigned int workers = Parallel_getNumWorkers();
+  SumSlot slots[workers];
+  for (unsigned int w = 0; w < workers; w++) {
+    slots[w].value = 0;
+  }
+  SumContext sum = { .body = body, .context = context, .slots = slots };
+  Parallel_for(n, grain, sum_range, &sum);
+
+  unsigned long total = 0;
+  for (unsigned int w = 0; w < workers; w++) {
+    total += slots[w].value;
+  }
+  return total;
+}
+
+#if defined(PARALLEL_SERIAL)
+
+unsigned int Parallel_getNumWorkers() {
+  return 1;
+}
+
+unsigned int Parallel_getWorkerId() {
+  return 0;
+}
+
+void Parallel_for(unsigned int n, unsigned int grain, ParallelForBody body,
+                  void* context) {
+#ifdef WORK_SPAN
+  WorkSpan_for(n, grain, body, context);
+  return;
+#endif
+  if (n > 0) {
+    run_body(body, context, 0, n);
+  }
+}
+
+void Parallel_onEachWorker(void (*fn)(unsigned int workerId)) {
+  fn(0);
+}
+
+#elif defined(PARALLEL_OPENMP)
+
+unsigned int Parallel_getWorkerId() {
+  return omp_get_thread_num();
+}
+
+// Runs each range of grain iterations as an OpenMP task, and waits for them.
+static void run_ranges(unsigned int n, unsigned int grain,
+                       ParallelForBody body, void* context) {
+  unsigned int numRanges = (n + grain - 1) / grain;
+  #pragma omp taskloop grainsize(1)
+  for (unsigned int r = 0; r < numRanges; r++) {
+    unsigned int begin = r * grain;
+    unsigned int end = n - begin > grain ? begin + grain : n;
+    run_body(body, context, begin, end);
+  }
+}
+
+void Parallel_for(unsigned int n, unsigned int grain, ParallelForBody body,
+                  void* context) {
+#ifdef WORK_SPAN
+  WorkSpan_for(n, grain, body, context);
+  return;
+#endif
+  if (grain == 0) {
+    grain = 1;
+  }
+  if (n == 0) {
+    return;
+  }
+  if (n <= grain || Parallel_getNumWorkers() == 1) {
+    run_body(body, context, 0, n);
+    return;
+  }
+
+  // Nested loops add their tasks to the team that is already running.
+  if (omp_in_parallel()) {
+    run_ranges(n, grain, body, context);
+    return;
+  }
+  #pragma omp parallel num_threads(numWorkers)
+  #pragma omp single
+  run_ranges(n, grain, body, context);
+}
+
+void Parallel_onEachWorker(void (*fn)(unsigned int workerId)) {
+  #pragma omp parallel num_threads(Parallel_getNumWorkers())
+  fn(omp_get_thread_num());
+}
+
+#elif defined(PARALLEL_PTHREADS)
+
+// Tasks each worker's deque can hold; a worker that finds its deque full
+// runs the work itself instead
+#define PARALLEL_DEQUE_SIZE 256
+// Times an idle worker looks for a task before going to sleep
+#define PARALLEL_SPIN_COUNT 1024
+
+// A range of a loop's iterations.  pending counts the loop's tasks that
+// have been pushed but not yet finished.
+typedef struct {
+  ParallelForBody body;
+  void* context;
+  unsigned int begin;
+  unsigned int end;
+  unsigned int grain;
+  unsigned int* pending;
+} Task;
+
+// A worker's tasks.  The worker pushes and pops at the tail, and thieves
+// take from the head, where the largest ranges are.  head and tail only
+// change under lock, but are read without it to skip empty deques.
+typedef struct {
+  pthread_mutex_t lock;
+  unsigned int head;
+  unsigned int tail;
+  Task tasks[PARALLEL_DEQUE_SIZE];
+} __attribute__((aligned(64))) Deque;
+
+static Deque* deques = NULL;
+static __thread unsigned int workerId = 0;
+
+// Sleeping workers wait on wake; numSleeping tells pushers to wake them.
+static pthread_mutex_t sleepLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static unsigned int numSleeping = 0;
+
+// Parallel_onEachWorker() bumps broadcastGeneration to have every other
+// worker run broadcastFn once; broadcastPending counts those yet to.
+static void (*broadcastFn)(unsigned int workerId) = NULL;
+static unsigned int broadcastGeneration = 0;
+static unsigned int broadcastPending = 0;
+static __thread unsigned int seenGeneration = 0;
+
+unsigned int Parallel_getWorkerId() {
+  return workerId;
+}
+
+static bool push_task(const Task* task) {
+  Deque* deque = &deques[workerId];
+  pthread_mutex_lock(&deque->lock);
+  bool pushed = deque->tail - deque->head < PARALLEL_DEQUE_SIZE;
+  if (pushed) {
+    deque->tasks[deque->tail % PARALLEL_DEQUE_SIZE] = *task;
+    __atomic_store_n(&deque->tail, deque->tail + 1, __ATOMIC_SEQ_CST);
+  }
+  pthread_mutex_unlock(&deque->lock);
+
+  if (pushed && __atomic_load_n(&numSleeping, __ATOMIC_SEQ_CST) > 0) {
+    pthread_mutex_lock(&sleepLock);
+    pthread_cond_broadcast(&wake);
+    pthread_mutex_unlock(&sleepLock);
+  }
+  return pushed;
+}
+
+// Takes a task from the worker's own deque, newest first, or else steals
+// the oldest task of another worker.
+static bool find_task(Task* task) {
+  for (unsigned int i = 0; i < numWorkers; i++) {
+    unsigned int victim = (workerId + i) % numWorkers;
+    Deque* deque = &deques[victim];
+    if (__atomic_load_n(&deque->head, __ATOMIC_SEQ_CST)
+        == __atomic_load_n(&deque->tail, __ATOMIC_SEQ_CST)) {
+      continue;
+    }
+    bool found = false;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->head != deque->tail) {
+      if (victim == workerId) {
+        *task = deque->tasks[(deque->tail - 1) % PARALLEL_DEQUE_SIZE];
+        __atomic_store_n(&deque->tail, deque->tail - 1, __ATOMIC_SEQ_CST);
+      } else {
+        *task = deque->tasks[deque->head % PARALLEL_DEQUE_SIZE];
+        __atomic_store_n(&deque->head, deque->head + 1, __ATOMIC_SEQ_CST);
+      }
+      found = true;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    if (found) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Runs task's range: while it is larger than the grain, the upper half is
+// pushed for any worker to take, and the lower half is kept.
+static void run_task(const Task* task) {
+  unsigned int begin = task->begin;
+  unsigned int end = task->end;
+  while (end - begin > task->grain) {
+    unsigned int mid = begin + (end - begin) / 2;
+    Task half = *task;
+    half.begin = mid;
+    half.end = end;
+    __atomic_fetch_add(task->pending, 1, __ATOMIC_SEQ_CST);
+    if (!push_task(&half)) {
+      __atomic_fetch_sub(task->pending, 1, __ATOMIC_SEQ_CST);
+      break;
+    }
+    end = mid;
+  }
+  run_body(task->body, task->context, begin, end);
+}
+
+// Runs a task taken from a deque, then marks it finished.
+static void run_found_task(const Task* task) {
+  run_task(task);
+  __atomic_fetch_sub(task->pending, 1, __ATOMIC_RELEASE);
+}
+
+// Whether a Parallel_onEachWorker() call is waiting for this worker
+static bool broadcast_waiting() {
+  return __atomic_load_n(&broadcastGeneration, __ATOMIC_ACQUIRE)
+      != seenGeneration;
+}
+
+static void* worker_main(void* arg) {
+  workerId = (uintptr_t) arg;
+  for (;;) {
+    if (broadcast_waiting()) {
+      seenGeneration = __atomic_load_n(&broadcastGeneration,
+                                       __ATOMIC_ACQUIRE);
+      broadcastFn(workerId);
+      __atomic_fetch_sub(&broadcastPending, 1, __ATOMIC_RELEASE);
+    }
+
+    Task task;
+    bool found = false;
+    for (int spin = 0; spin < PARALLEL_SPIN_COUNT && !found; spin++) {
+      found = find_task(&task);
+      if (!found) {
+        sched_yield();
+      }
+    }
+    if (found) {
+      run_found_task(&task);
+      continue;
+    }
+
+    // Announce the sleep before looking one last time, so that a push
+    // either is seen here or sees this worker asleep and wakes it.
+    pthread_mutex_lock(&sleepLock);
+    __atomic_fetch_add(&numSleeping, 1, __ATOMIC_SEQ_CST);
+    found = find_task(&task);
+    if (!found && !broadcast_waiting()) {
+      pthread_cond_wait(&wake, &sleepLock);
+    }
+    __atomic_fetch_sub(&numSleeping, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&sleepLock);
+    if (found) {
+      run_found_task(&task);
+    }
+  }
+  return NULL;
+}
+
+// Starts the workers other than the calling thread, the first time.
+static void start_workers() {
+  if (deques != NULL) {
+    return;
+  }
+  Parallel_getNumWorkers();
+  int error = posix_memalign((void**) &deques, 64,
+                             sizeof(Deque) * numWorkers);
+  assert(error == 0);
+  (void) error;
+  for (unsigned int w = 0; w < numWorkers; w++) {
+    pthread_mutex_init(&deques[w].lock, NULL);
+    deques[w].head = 0;
+    deques[w].tail = 0;
+  }
+  for (unsigned int w = 1; w < numWorkers; w++) {
+    pthread_t thread;
+    pthread_create(&thread, NULL, worker_main, (void*) (uintptr_t) w);
+    pthread_detach(thread);
+  }
+}
+
+void Parallel_for(unsigned int n, unsigned int grain, ParallelForBody body,
+                  void* context) {
+#ifdef WORK_SPAN
+  WorkSpan_for(n, grain, body, context);
+  return;
+#endif
+  if (grain == 0) {
+    grain = 1;
+  }
+  if (n == 0) {
+    return;
+  }
+  if (n <= grain || Parallel_getNumWorkers() == 1) {
+    run_body(body, context, 0, n);
+    return;
+  }
+  start_workers();
+
+  // Run our share, then help with whatever work is about until every range
+  // of this loop has finished.
+  unsigned int pending = 0;
+  Task task = {
+    .body = body, .context = context, .begin = 0, .end = n, .grain = grain,
+    .pending = &pending
+  };
+  run_task(&task);
+  while (__atomic_load_n(&pending, __ATOMIC_ACQUIRE) > 0) {
+    Task other;
+    if (find_task(&other)) {
+      run_found_task(&other);
+    } else {
+      sched_yield();
+    }
+  }
+}
+
+void Parallel_onEachWorker(void (*fn)(unsigned int workerId)) {
+  if (Parallel_getNumWorkers() > 1) {
+    start_workers();
+    broadcastFn = fn;
+    broadcastPending = numWorkers - 1;
+    __atomic_fetch_add(&broadcastGeneration, 1, __ATOMIC_RELEASE);
+    pthread_mutex_lock(&sleepLock);
+    pthread_cond_broadcast(&wake);
+    pthread_mutex_unlock(&sleepLock);
+  }
+  fn(0);
+  while (__atomic_load_n(&broadcastPending, __ATOMIC_ACQUIRE) > 0) {
+    sched_yield();
+  }
+}
+
+#endif
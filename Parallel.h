@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Task-parallel loops behind one interface, with the backend chosen at
+// build time by defining one of:
+//
+//   PARALLEL_OPENMP    OpenMP tasks
+//   PARALLEL_PTHREADS  a pool of pthreads with work-stealing deques
+//   PARALLEL_SERIAL    everything runs on the calling thread
+//
+// The Makefile picks one with PARALLEL=openmp|pthreads|serial.  Loops may
+// be nested: a loop started from inside another loop's body shares the
+// same workers.
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#if !defined(PARALLEL_OPENMP) && !defined(PARALLEL_PTHREADS) \
+    && !defined(PARALLEL_SERIAL)
+#define PARALLEL_SERIAL
+#endif
+
+// Environment variable giving the number of workers when
+// Parallel_setNumWorkers() is not called
+#define PARALLEL_WORKERS_ENV "SCREENSAVER_WORKERS"
+
+// Body of a parallel loop: handles the iterations from begin up to end.
+typedef void (*ParallelForBody)(void* context, unsigned int begin,
+                                unsigned int end);
+
+// Body of a parallel sum: returns the sum over the iterations from begin up
+// to end.
+typedef unsigned long (*ParallelSumBody)(void* context, unsigned int begin,
+                                         unsigned int end);
+
+// Sets the number of workers, including the calling thread.  Only takes
+// effect if called before the number of workers is first asked for.
+// Without it, the number comes from PARALLEL_WORKERS_ENV, or else is the
+// number of online processors.
+void Parallel_setNumWorkers(unsigned int numWorkers);
+
+// Returns the number of workers; always 1 for the serial backend.
+unsigned int Parallel_getNumWorkers();
+
+// Returns the calling worker's number, from 0 up to the number of workers.
+// The thread that starts the outermost loop is worker 0.
+unsigned int Parallel_getWorkerId();
+
+// Runs body over the iterations from 0 up to n, handing out ranges of at
+// most grain iterations (a grain of 0 counts as 1), and returns once every
+// iteration has run.
+void Parallel_for(unsigned int n, unsigned int grain, ParallelForBody body,
+                  void* context);
+
+// Like Parallel_for(), and returns the sum of what body returned.
+unsigned long Parallel_sum(unsigned int n, unsigned int grain,
+                           ParallelSumBody body, void* context);
+
+// Runs fn once on the thread of every worker, passing the worker's number,
+// and returns once all have run.  For per-thread setup; called outside of
+// any loop, from the thread that starts loops.
+void Parallel_onEachWorker(void (*fn)(unsigned int workerId));
+
+#endif  // PARALLEL_H_
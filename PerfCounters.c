@@ -0,0 +1,286 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// For syscall(); fasttime.h would otherwise limit us to POSIX
+#define _GNU_SOURCE
+
+#include "./PerfCounters.h"
+
+#ifdef PERF_COUNTERS
+
+#include <assert.h>
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "./Parallel.h"
+
+typedef enum {
+  EVENT_CYCLES,
+  EVENT_INSTRUCTIONS,
+  EVENT_L1D_MISSES,
+  EVENT_LLC_MISSES,
+  EVENT_BRANCH_MISSES,
+  EVENT_TASK_CLOCK,  // nanoseconds of CPU time
+  EVENT_NUM
+} Event;
+
+static const struct {
+  const char* name;
+  uint32_t type;
+  uint64_t config;
+} PerfCounters_events[EVENT_NUM] = {
+  [EVENT_CYCLES] = { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  [EVENT_INSTRUCTIONS] = { "instructions", PERF_TYPE_HARDWARE,
+                           PERF_COUNT_HW_INSTRUCTIONS },
+  [EVENT_L1D_MISSES] = { "L1d misses", PERF_TYPE_HW_CACHE,
+                         PERF_COUNT_HW_CACHE_L1D
+                         | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                         | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+  [EVENT_LLC_MISSES] = { "LLC misses", PERF_TYPE_HARDWARE,
+                         PERF_COUNT_HW_CACHE_MISSES },
+  [EVENT_BRANCH_MISSES] = { "branch misses", PERF_TYPE_HARDWARE,
+                            PERF_COUNT_HW_BRANCH_MISSES },
+  [EVENT_TASK_CLOCK] = { "task-clock", PERF_TYPE_SOFTWARE,
+                         PERF_COUNT_SW_TASK_CLOCK },
+};
+
+// A counter's value with PERF_FORMAT_TOTAL_TIME_ENABLED and _RUNNING; when
+// the kernel multiplexes counters, running is less than enabled.
+typedef struct {
+  uint64_t value;
+  uint64_t enabled;
+  uint64_t running;
+} Reading;
+
+static bool PerfCounters_opened = false;
+static unsigned int PerfCounters_numWorkers;
+// fds[w * EVENT_NUM + e] is worker w's counter of event e, or -1
+static int* PerfCounters_fds;
+// errno of a failed open, per worker and event
+static int* PerfCounters_errors;
+// Readings taken by PerfCounters_start()
+static Reading* PerfCounters_before;
+// Counts of the current frame and of all past frames, per worker, phase and
+// event: [(w * PHASE_NUM + p) * EVENT_NUM + e]
+static double* PerfCounters_current;
+static double* PerfCounters_totals;
+static unsigned int PerfCounters_numFrames = 0;
+
+static int perf_event_open(struct perf_event_attr* attr, pid_t pid, int cpu,
+                           int groupFd, unsigned long flags) {
+  return syscall(SYS_perf_event_open, attr, pid, cpu, groupFd, flags);
+}
+
+// Opens the calling worker's counters, which count that thread only.
+static void open_worker(unsigned int w) {
+  for (int e = 0; e < EVENT_NUM; e++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PerfCounters_events[e].type;
+    attr.config = PerfCounters_events[e].config;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+        | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    int fd = perf_event_open(&attr, 0, -1, -1, 0);
+    PerfCounters_fds[w * EVENT_NUM + e] = fd;
+    PerfCounters_errors[w * EVENT_NUM + e] = fd < 0 ? errno : 0;
+  }
+}
+
+static void open_counters() {
+  unsigned int n = Parallel_getNumWorkers();
+  PerfCounters_numWorkers = n;
+  PerfCounters_fds = malloc(sizeof(int) * n * EVENT_NUM);
+  PerfCounters_errors = malloc(sizeof(int) * n * EVENT_NUM);
+  PerfCounters_before = malloc(sizeof(Reading) * n * EVENT_NUM);
+  PerfCounters_current = calloc(n * PHASE_NUM * EVENT_NUM, sizeof(double));
+  PerfCounters_totals = calloc(n * PHASE_NUM * EVENT_NUM, sizeof(double));
+  assert(PerfCounters_fds != NULL && PerfCounters_errors != NULL
+         && PerfCounters_before != NULL && PerfCounters_current != NULL
+         && PerfCounters_totals != NULL);
+  Parallel_onEachWorker(open_worker);
+  PerfCounters_opened = true;
+}
+
+static void read_counters(Reading* readings) {
+  for (unsigned int i = 0; i < PerfCounters_numWorkers * EVENT_NUM; i++) {
+    if (PerfCounters_fds[i] < 0
+        || read(PerfCounters_fds[i], &readings[i], sizeof(Reading))
+           != sizeof(Reading)) {
+      readings[i] = (Reading) { 0, 0, 0 };
+    }
+  }
+}
+
+void PerfCounters_start() {
+  if (!PerfCounters_opened) {
+    open_counters();
+  }
+  read_counters(PerfCounters_before);
+}
+
+void PerfCounters_stop(Phase phase) {
+  Reading after[PerfCounters_numWorkers * EVENT_NUM];
+  read_counters(after);
+  for (unsigned int w = 0; w < PerfCounters_numWorkers; w++) {
+    for (int e = 0; e < EVENT_NUM; e++) {
+      const Reading* a = &PerfCounters_before[w * EVENT_NUM + e];
+      const Reading* b = &after[w * EVENT_NUM + e];
+      uint64_t running = b->running - a->running;
+      if (running == 0) {
+        continue;
+      }
+      // Scale up counts taken while the counter was multiplexed out
+      double count = (double) (b->value - a->value)
+          * (double) (b->enabled - a->enabled) / (double) running;
+      PerfCounters_current[(w * PHASE_NUM + phase) * EVENT_NUM + e] += count;
+    }
+  }
+}
+
+void PerfCounters_endFrame() {
+  if (!PerfCounters_opened) {
+    return;
+  }
+  for (unsigned int i = 0;
+       i < PerfCounters_numWorkers * PHASE_NUM * EVENT_NUM; i++) {
+    PerfCounters_totals[i] += PerfCounters_current[i];
+    PerfCounters_current[i] = 0;
+  }
+  PerfCounters_numFrames++;
+}
+
+// Whether any worker could open event e
+static bool is_available(int e) {
+  for (unsigned int w = 0; w < PerfCounters_numWorkers; w++) {
+    if (PerfCounters_fds[w * EVENT_NUM + e] >= 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Prints one table row from per-frame event counts.
+static void print_row(const char* name, const double* counts) {
+  char text[EVENT_NUM + 2][16];
+  for (int e = 0; e < EVENT_NUM + 2; e++) {
+    strcpy(text[e], "n/a");
+  }
+  double instructions = counts[EVENT_INSTRUCTIONS];
+  if (is_available(EVENT_CYCLES)) {
+    snprintf(text[0], sizeof(text[0]), "%.4g", counts[EVENT_CYCLES]);
+  }
+  if (is_available(EVENT_INSTRUCTIONS)) {
+    snprintf(text[1], sizeof(text[1]), "%.4g", instructions);
+    if (is_available(EVENT_CYCLES) && counts[EVENT_CYCLES] > 0) {
+      snprintf(text[2], sizeof(text[2]), "%.2f",
+               instructions / counts[EVENT_CYCLES]);
+    }
+  }
+  // Misses per thousand instructions
+  const Event misses[] = {
+    EVENT_L1D_MISSES, EVENT_LLC_MISSES, EVENT_BRANCH_MISSES
+  };
+  for (int i = 0; i < 3; i++) {
+    if (is_available(misses[i]) && is_available(EVENT_INSTRUCTIONS)
+        && instructions > 0) {
+      snprintf(text[3 + i], sizeof(text[3 + i]), "%.2f",
+               1e3 * counts[misses[i]] / instructions);
+    }
+  }
+  if (is_available(EVENT_TASK_CLOCK)) {
+    snprintf(text[6], sizeof(text[6]), "%.4f",
+             1e-6 * counts[EVENT_TASK_CLOCK]);
+  }
+  printf("%-10s %10s %10s %5s %9s %9s %9s %9s\n", name, text[0], text[1],
+         text[2], text[3], text[4], text[5], text[6]);
+}
+
+static void print_header(const char* first) {
+  printf("%-10s %10s %10s %5s %9s %9s %9s %9s\n", first, "cycles",
+         "instrs", "IPC", "L1d MPKI", "LLC MPKI", "br MPKI", "cpu ms");
+}
+
+void PerfCounters_print() {
+  if (!PerfCounters_opened || PerfCounters_numFrames == 0) {
+    return;
+  }
+  printf("---- PERF COUNTERS (%u frames, means per frame) ----\n",
+         PerfCounters_numFrames);
+  bool any = false;
+  for (int e = 0; e < EVENT_NUM; e++) {
+    if (is_available(e)) {
+      any = true;
+    } else {
+      printf("%s unavailable: %s\n", PerfCounters_events[e].name,
+             strerror(PerfCounters_errors[e]));
+    }
+  }
+  if (!any) {
+    printf("---- END PERF COUNTERS ----\n");
+    return;
+  }
+
+  unsigned int n = PerfCounters_numWorkers;
+  double scale = 1.0 / PerfCounters_numFrames;
+  double counts[EVENT_NUM];
+  double frame[EVENT_NUM] = { 0 };
+  print_header("phase");
+  for (int p = 0; p < PHASE_NUM; p++) {
+    for (int e = 0; e < EVENT_NUM; e++) {
+      counts[e] = 0;
+      for (unsigned int w = 0; w < n; w++) {
+        counts[e] += scale
+            * PerfCounters_totals[(w * PHASE_NUM + p) * EVENT_NUM + e];
+      }
+      frame[e] += counts[e];
+    }
+    print_row(PhaseTimer_names[p], counts);
+  }
+  print_row("frame", frame);
+
+  print_header("worker");
+  for (unsigned int w = 0; w < n; w++) {
+    for (int e = 0; e < EVENT_NUM; e++) {
+      counts[e] = 0;
+      for (int p = 0; p < PHASE_NUM; p++) {
+        counts[e] += scale
+            * PerfCounters_totals[(w * PHASE_NUM + p) * EVENT_NUM + e];
+      }
+    }
+    char name[16];
+    snprintf(name, sizeof(name), "%u", w);
+    print_row(name, counts);
+  }
+  printf("---- END PERF COUNTERS ----\n");
+}
+
+#endif  // PERF_COUNTERS
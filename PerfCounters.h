@@ -0,0 +1,51 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Hardware performance counters per phase.  Built with -DPERF_COUNTERS
+// ("make PERF=1", which also turns on the phase timers), every worker counts
+// cycles, instructions, cache misses, branch mispredicts and CPU time with
+// Linux perf_event_open(2), and PhaseTimer reads the counters at the start
+// and end of each phase.  Counters the kernel or hardware does not provide
+// are reported as unavailable and the rest still work.
+#ifndef PERFCOUNTERS_H_
+#define PERFCOUNTERS_H_
+
+#ifdef PERF_COUNTERS
+
+#include "./PhaseTimer.h"
+
+// Opens the counters on the first call, then reads them.  Called by
+// PhaseTimer_start() from the thread that runs the frames, outside of any
+// parallel loop.
+void PerfCounters_start();
+
+// Adds every worker's counts since PerfCounters_start() to phase.
+void PerfCounters_stop(Phase phase);
+
+void PerfCounters_endFrame();
+
+// Prints per-frame means for each phase and for each worker.
+void PerfCounters_print();
+
+#endif  // PERF_COUNTERS
+
+#endif  // PERFCOUNTERS_H_
@@ -0,0 +1,154 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "./PhaseTimer.h"
+
+#ifdef PHASE_TIMERS
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef PERF_COUNTERS
+#include "./PerfCounters.h"
+#endif
+#include "./Trace.h"
+#include "./WorkSpan.h"
+
+const char* PhaseTimer_names[PHASE_NUM] = {
+  [PHASE_BUILD] = "build",
+  [PHASE_PAIRS] = "pairs",
+  [PHASE_MERGE] = "merge",
+  [PHASE_SORT] = "sort",
+  [PHASE_SOLVE] = "solve",
+  [PHASE_MOVE] = "move",
+  [PHASE_TEARDOWN] = "teardown",
+};
+
+// Time spent in each phase in the current frame
+static double PhaseTimer_current[PHASE_NUM];
+
+// Time spent in each phase, then in the whole frame, in every past frame:
+// frame f's times start at PhaseTimer_samples[f * (PHASE_NUM + 1)].
+static double* PhaseTimer_samples = NULL;
+static unsigned int PhaseTimer_numFrames = 0;
+static unsigned int PhaseTimer_capacity = 0;
+
+fasttime_t PhaseTimer_start() {
+#ifdef PERF_COUNTERS
+  PerfCounters_start();
+#endif
+#ifdef WORK_SPAN
+  WorkSpan_start();
+#endif
+  return gettime();
+}
+
+void PhaseTimer_stop(Phase phase, fasttime_t start) {
+  PhaseTimer_current[phase] += tdiff(start, gettime());
+#ifdef PERF_COUNTERS
+  PerfCounters_stop(phase);
+#endif
+#ifdef TIMELINE_TRACE
+  Trace_phase(PhaseTimer_names[phase], start);
+#endif
+#ifdef WORK_SPAN
+  WorkSpan_stop(phase);
+#endif
+}
+
+void PhaseTimer_endFrame() {
+  if (PhaseTimer_numFrames == PhaseTimer_capacity) {
+    PhaseTimer_capacity = PhaseTimer_capacity == 0 ? 1024
+        : 2 * PhaseTimer_capacity;
+    PhaseTimer_samples = realloc(
+        PhaseTimer_samples,
+        sizeof(double) * (PHASE_NUM + 1) * PhaseTimer_capacity);
+    assert(PhaseTimer_samples != NULL);
+  }
+  double* frame = &PhaseTimer_samples[PhaseTimer_numFrames * (PHASE_NUM + 1)];
+  double total = 0;
+  for (int p = 0; p < PHASE_NUM; p++) {
+    frame[p] = PhaseTimer_current[p];
+    total += PhaseTimer_current[p];
+    PhaseTimer_current[p] = 0;
+  }
+  frame[PHASE_NUM] = total;
+  PhaseTimer_numFrames++;
+#ifdef PERF_COUNTERS
+  PerfCounters_endFrame();
+#endif
+#ifdef TIMELINE_TRACE
+  Trace_endFrame();
+#endif
+#ifdef WORK_SPAN
+  WorkSpan_endFrame();
+#endif
+}
+
+static int PhaseTimer_compare(const void* a, const void* b) {
+  double x = *(const double*) a;
+  double y = *(const double*) b;
+  return (x > y) - (x < y);
+}
+
+// Returns the nearest-rank percentile of the n sorted times.
+static double PhaseTimer_percentile(const double* sorted, unsigned int n,
+                                    unsigned int percent) {
+  unsigned int rank = (n * percent + 99) / 100;
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+void PhaseTimer_print() {
+  unsigned int n = PhaseTimer_numFrames;
+  if (n == 0) {
+    return;
+  }
+  double* times = malloc(sizeof(double) * n);
+  assert(times != NULL);
+
+  double frameTotal = 0;
+  for (unsigned int f = 0; f < n; f++) {
+    frameTotal += PhaseTimer_samples[f * (PHASE_NUM + 1) + PHASE_NUM];
+  }
+
+  printf("---- PHASE TIMES (%u frames) ----\n", n);
+  printf("%-10s %10s %7s %10s %10s\n", "phase", "total s", "share",
+         "p50 ms", "p99 ms");
+  for (int p = 0; p <= PHASE_NUM; p++) {
+    double total = 0;
+    for (unsigned int f = 0; f < n; f++) {
+      times[f] = PhaseTimer_samples[f * (PHASE_NUM + 1) + p];
+      total += times[f];
+    }
+    qsort(times, n, sizeof(double), PhaseTimer_compare);
+    printf("%-10s %10.6f %6.1f%% %10.4f %10.4f\n",
+           p < PHASE_NUM ? PhaseTimer_names[p] : "frame", total,
+           frameTotal > 0 ? 100 * total / frameTotal : 0,
+           1e3 * PhaseTimer_percentile(times, n, 50),
+           1e3 * PhaseTimer_percentile(times, n, 99));
+  }
+  printf("---- END PHASE TIMES ----\n");
+  free(times);
+}
+
+#endif  // PHASE_TIMERS
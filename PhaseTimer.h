@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Per-phase frame timers.  Built with -DPHASE_TIMERS ("make TIMERS=1"), each
+// phase of a frame is timed and Screensaver prints a breakdown at the end of
+// the run; otherwise the timing macros expand to nothing.  Built with
+// -DPERF_COUNTERS as well ("make PERF=1"), each phase also reads the
+// hardware counters of PerfCounters.h; with -DTIMELINE_TRACE each phase is
+// also recorded in the timeline of Trace.h, and with -DWORK_SPAN its work
+// and span are measured by WorkSpan.h.
+#ifndef PHASETIMER_H_
+#define PHASETIMER_H_
+
+// The timed phases of a frame, in the order they run
+typedef enum {
+  PHASE_BUILD,     // bring the broad phase's structure up to date
+  PHASE_PAIRS,     // find and test candidate pairs
+  PHASE_MERGE,     // merge the workers' event buffers
+  PHASE_SORT,      // sort the events by line IDs
+  PHASE_SOLVE,     // resolve the collisions
+  PHASE_MOVE,      // update positions and handle wall collisions
+  PHASE_TEARDOWN,  // release the frame's memory
+  PHASE_NUM
+} Phase;
+
+#ifdef PHASE_TIMERS
+
+#include "./fasttime.h"
+
+// Starts a timer named timer.
+#define PHASE_START(timer) fasttime_t timer = PhaseTimer_start()
+// Adds the time since timer started to phase.
+#define PHASE_STOP(timer, phase) PhaseTimer_stop((phase), (timer))
+// Ends the frame, recording each phase's time in it.
+#define PHASE_END_FRAME() PhaseTimer_endFrame()
+
+// Returns the current time.  Phases do not nest, and are only timed from
+// the thread that runs the frames.
+fasttime_t PhaseTimer_start();
+
+// Adds the time since start to phase in the current frame.
+void PhaseTimer_stop(Phase phase, fasttime_t start);
+
+void PhaseTimer_endFrame();
+
+// Short name of each phase
+extern const char* PhaseTimer_names[PHASE_NUM];
+
+// Prints each phase's total time, share of the frame and per-frame 50th and
+// 99th percentiles.
+void PhaseTimer_print();
+
+#else
+
+#define PHASE_START(timer)
+#define PHASE_STOP(timer, phase)
+#define PHASE_END_FRAME()
+
+#endif  // PHASE_TIMERS
+
+#endif  // PHASETIMER_H_
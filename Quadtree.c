@@ -1,166 +1,635 @@
 #include "./Quadtree.h"
 
-// Make new Quadtree, lines and points not set.
-Quadtree make_quadtree(unsigned int capacity, double x_lo, double y_lo,
+#include <string.h>
+
+#include "./CollisionStats.h"
+#include "./Parallel.h"
+
+// Size class of a lines array with room for capacity lines
+static inline unsigned int bucket_class(LineQuadtree * qt, unsigned int capacity) {
+  unsigned int k = __builtin_ctz(capacity / qt->params.leafCapacity);
+  assert(k < QUADTREE_BUCKET_CLASSES);
+  assert(qt->params.leafCapacity << k == capacity);
+  return k;
+}
+
+// Get a lines array with room for leafCapacity << k lines, reusing a freed
+// one if there is one
+static unsigned int * alloc_bucket(LineQuadtree * qt, unsigned int k) {
+  void * bucket = qt->freeBuckets[k];
+  if (bucket != NULL) {
+    qt->freeBuckets[k] = *(void **) bucket;
+    return bucket;
+  }
+  // leave room for the free list link even in the smallest arrays
+  size_t size = sizeof(unsigned int) * ((size_t) qt->params.leafCapacity << k);
+  return Arena_alloc(qt->arena, MAX(size, sizeof(void *)));
+}
+
+// Put a lines array with room for capacity lines on its free list
+static void free_bucket(LineQuadtree * qt, unsigned int * lines, unsigned int capacity) {
+  unsigned int k = bucket_class(qt, capacity);
+  *(void **) lines = qt->freeBuckets[k];
+  qt->freeBuckets[k] = lines;
+}
+
+// Make new empty Quadtree, reusing a freed node if there is one
+Quadtree * make_quadtree(LineQuadtree * qt, double x_lo, double y_lo,
   double x_hi, double y_hi, unsigned int depth, Quadtree * parent) {
-  Quadtree new_tree = {
+  Quadtree * tree = qt->freeNodes;
+  if (tree != NULL) {
+    qt->freeNodes = tree->quadrant_1;
+  } else {
+    tree = Arena_alloc(qt->arena, sizeof(Quadtree));
+  }
+  *tree = (Quadtree) {
     .quadrant_1 = NULL, .quadrant_2 = NULL, .quadrant_3 = NULL,
-    .quadrant_4 = NULL, .lines = malloc(sizeof(Line *) * capacity),
-    .numOfLines = 0, .capacity = capacity, .p1 = { .x = x_lo, .y = y_lo },
+    .quadrant_4 = NULL, .lines = alloc_bucket(qt, 0),
+    .numOfLines = 0, .capacity = qt->params.leafCapacity,
+    .splitThreshold = qt->params.leafCapacity, .p1 = { .x = x_lo, .y = y_lo },
     .p2 = { .x = x_hi, .y = y_hi }, .depth = depth, .parent = parent
   };
-  return new_tree;
+  return tree;
 }
 
-// Parse the CollisionWorld into a Quadtree
-Quadtree* parse_CollisionWorld_to_Quadtree(CollisionWorld * world, Quadtree ** quadtrees, int * numQuadtrees) {
-  Quadtree *tree = malloc(sizeof(Quadtree));
-  *tree = make_quadtree(N, BOX_XMIN, BOX_YMIN, BOX_XMAX, BOX_YMAX, 0, NULL);
-  quadtrees[*numQuadtrees] = tree;
-  *numQuadtrees += 1;
-  for (int i = 0; i < world->numOfLines; i++) {
-    Line *l = world->lines[i];
-    insert_line(l, tree, quadtrees, numQuadtrees);
+// Set up an empty LineQuadtree for the lines in store, holding only the root
+static void make_LineQuadtree(LineQuadtree * qt, const LineStore * store, QuadtreeParams params,
+  Arena * arena) {
+  assert(params.leafCapacity > 0);
+  qt->params = params;
+  qt->arena = arena;
+  qt->freeNodes = NULL;
+  for (int k = 0; k < QUADTREE_BUCKET_CLASSES; k++) {
+    qt->freeBuckets[k] = NULL;
+  }
+  qt->quadtreesCapacity = 1 + 4 * 4;
+  qt->quadtrees = Arena_alloc(arena, sizeof(Quadtree *) * qt->quadtreesCapacity);
+  qt->lineNode = Arena_alloc(arena, sizeof(Quadtree *) * store->numOfLines);
+  qt->lineSlot = Arena_alloc(arena, sizeof(unsigned int) * store->numOfLines);
+  qt->lineMoves = Arena_alloc(arena, sizeof(bool) * store->numOfLines);
+  qt->members = Arena_alloc(arena, sizeof(unsigned int) * store->numOfLines);
+  memset(qt->lineNode, 0, sizeof(Quadtree *) * store->numOfLines);
+  qt->numOfLines = store->numOfLines;
+  qt->numMembers = 0;
+  qt->nodesChanged = false;
+
+  qt->root = make_quadtree(qt, BOX_XMIN, BOX_YMIN, BOX_XMAX, BOX_YMAX, 0, NULL);
+  qt->quadtrees[0] = qt->root;
+  qt->numQuadtrees = 1;
+}
+
+// Store l in tree itself, growing its lines array if needed
+static inline void store_line(LineQuadtree * qt, unsigned int l, Quadtree * tree) {
+  // double node's line capacity if full
+  if (tree->numOfLines == tree->capacity) {
+    unsigned int * lines = alloc_bucket(qt, bucket_class(qt, tree->capacity) + 1);
+    memcpy(lines, tree->lines, sizeof(unsigned int) * tree->numOfLines);
+    free_bucket(qt, tree->lines, tree->capacity);
+    tree->lines = lines;
+    tree->capacity *= 2;
+  }
+  qt->lineNode[l] = tree;
+  qt->lineSlot[l] = tree->numOfLines;
+  tree->lines[tree->numOfLines++] = l;
+}
+
+// Take l out of the node currently holding it
+static inline void remove_line(LineQuadtree * qt, unsigned int l) {
+  Quadtree * tree = qt->lineNode[l];
+  unsigned int slot = qt->lineSlot[l];
+  assert(tree->lines[slot] == l);
+
+  // move the node's last line into the vacated slot
+  unsigned int last = tree->lines[--tree->numOfLines];
+  tree->lines[slot] = last;
+  qt->lineSlot[last] = slot;
+  qt->lineNode[l] = NULL;
+
+  // let a leaf that declined to split be reconsidered once it has emptied out
+  if (tree->numOfLines < tree->splitThreshold / 4
+      && tree->splitThreshold > qt->params.leafCapacity) {
+    tree->splitThreshold = MAX(qt->params.leafCapacity, tree->splitThreshold / 2);
+  }
+}
+
+// Bounds of quadrant q (1 to 4, numbered as in Quadtree) of tree
+static inline void quadrant_bounds(Quadtree * tree, int q, Vec * p1, Vec * p2) {
+  double x_mid = tree->p1.x + (tree->p2.x - tree->p1.x)/2;
+  double y_mid = tree->p1.y + (tree->p2.y - tree->p1.y)/2;
+  switch (q) {
+    case 1:
+      *p1 = (Vec) { .x = x_mid, .y = tree->p1.y };
+      *p2 = (Vec) { .x = tree->p2.x, .y = y_mid };
+      break;
+    case 2:
+      *p1 = (Vec) { .x = tree->p1.x, .y = tree->p1.y };
+      *p2 = (Vec) { .x = x_mid, .y = y_mid };
+      break;
+    case 3:
+      *p1 = (Vec) { .x = tree->p1.x, .y = y_mid };
+      *p2 = (Vec) { .x = x_mid, .y = tree->p2.y };
+      break;
+    default:
+      *p1 = (Vec) { .x = x_mid, .y = y_mid };
+      *p2 = (Vec) { .x = tree->p2.x, .y = tree->p2.y };
+      break;
+  }
+}
+
+// Number of pairs tested among n lines held in one node
+static inline double pair_count(double n) {
+  return n * (n - 1) / 2;
+}
+
+// Add four new nodes to qt->quadtrees.  An outgrown array stays in the
+// arena, which the doubling keeps to less than the size of the current one.
+static void append_quadtrees(LineQuadtree * qt, Quadtree * children[4]) {
+  if (qt->numQuadtrees + 4 > qt->quadtreesCapacity) {
+    qt->quadtreesCapacity = 2 * qt->quadtreesCapacity + 4;
+    Quadtree ** quadtrees = Arena_alloc(qt->arena, sizeof(Quadtree *) * qt->quadtreesCapacity);
+    memcpy(quadtrees, qt->quadtrees, sizeof(Quadtree *) * qt->numQuadtrees);
+    qt->quadtrees = quadtrees;
+  }
+  for (int q = 0; q < 4; q++) {
+    qt->quadtrees[qt->numQuadtrees++] = children[q];
+  }
+}
+
+// Give the leaf tree its four children and push its lines down into them
+static void split_quadtree(LineQuadtree * qt, const LineStore * store, Quadtree * tree) {
+  assert(tree->quadrant_1 == NULL);
+  assert(tree->quadrant_2 == NULL);
+  assert(tree->quadrant_3 == NULL);
+  assert(tree->quadrant_4 == NULL);
+
+  Quadtree * children[4];
+  for (int q = 0; q < 4; q++) {
+    Vec p1;
+    Vec p2;
+    quadrant_bounds(tree, q + 1, &p1, &p2);
+    children[q] = make_quadtree(qt, p1.x, p1.y, p2.x, p2.y, tree->depth+1, tree);
+  }
+  tree->quadrant_1 = children[0];
+  tree->quadrant_2 = children[1];
+  tree->quadrant_3 = children[2];
+  tree->quadrant_4 = children[3];
+
+  append_quadtrees(qt, children);
+
+  // reassign stuff currently in tree->line into new quadrants
+  reassign_current_to_quadrants(qt, store, tree);
+}
+
+// Index (0 to 3) of the first of the quadrants p1[q] to p2[q] that line fits
+// in, or 4 if it fits none
+static inline unsigned int quadrant_of(const LineStore * store, unsigned int line,
+  const Vec p1[4], const Vec p2[4]) {
+  unsigned int q = 0;
+  while (q < 4 && !can_fit_bounds(store, line, p1[q], p2[q])) {
+    q++;
+  }
+  return q;
+}
+
+// Whether splitting a leaf holding n lines, in_quadrant[q] of which fit
+// quadrant q and straddling of which fit none, is estimated to cost fewer
+// pair tests than leaving it alone
+static inline bool split_pays_off(const double in_quadrant[4], double straddling, double n) {
+  double cost_after = pair_count(straddling) + straddling * (n - straddling)
+    + 4 * QUADTREE_NODE_COST;
+  for (int q = 0; q < 4; q++) {
+    cost_after += pair_count(in_quadrant[q]);
+  }
+  return cost_after < pair_count(n);
+}
+
+// Split the overfull leaf tree if that is estimated to cost fewer pair tests
+// than leaving it alone.  After splitting, the lines that fit a quadrant are
+// only tested within that quadrant, while the lines that straddle quadrants
+// stay here and are still tested against every line.  Each new node is
+// charged QUADTREE_NODE_COST pair tests of overhead.  If the leaf is kept,
+// it is not reconsidered until it has doubled in size.
+static void split_if_cheaper(LineQuadtree * qt, const LineStore * store, Quadtree * tree) {
+  Vec p1[4];
+  Vec p2[4];
+  for (int q = 0; q < 4; q++) {
+    quadrant_bounds(tree, q + 1, &p1[q], &p2[q]);
+  }
+
+  double in_quadrant[4] = { 0, 0, 0, 0 };
+  double straddling = 0;
+  for (unsigned int i = 0; i < tree->numOfLines; i++) {
+    unsigned int q = quadrant_of(store, tree->lines[i], p1, p2);
+    if (q < 4) {
+      in_quadrant[q]++;
+    } else {
+      straddling++;
+    }
+  }
+
+  if (split_pays_off(in_quadrant, straddling, tree->numOfLines)) {
+    split_quadtree(qt, store, tree);
+  } else {
+    tree->splitThreshold = 2 * tree->numOfLines;
   }
-  return tree;
 }
 
 // Insert into the subtree hanging from (and including) tree
-void insert_line(Line* l, Quadtree * tree, Quadtree ** quadtrees, int * numQuadtrees) {
-  // if leaf node is not full, insert the line
-  if (tree->numOfLines < N && tree->quadrant_1 == NULL) {
-    tree->lines[tree->numOfLines++] = l;
-    return;
-  } else if (tree->depth == MAX_DEPTH) {
-    assert(tree->quadrant_1 == NULL);
-    assert(tree->quadrant_2 == NULL);
-    assert(tree->quadrant_3 == NULL);
-    assert(tree->quadrant_4 == NULL);
-
-    // if capacity is reached, double it
-    if (tree->numOfLines == tree->capacity) {
-      tree->lines = realloc(tree->lines, sizeof(Line *) * tree->capacity * 2);
-      assert(tree->lines);
-      tree->capacity *= 2;
-    }
-    tree->lines[tree->numOfLines++] = l;
+void insert_line(LineQuadtree * qt, const LineStore * store, unsigned int l, Quadtree * tree) {
+  // leaves take every line, and split once holding them gets too expensive
+  if (tree->quadrant_1 == NULL) {
+    store_line(qt, l, tree);
+    if (tree->numOfLines > tree->splitThreshold && tree->depth < qt->params.maxDepth) {
+      split_if_cheaper(qt, store, tree);
+    }
     return;
-  } else if (tree->quadrant_1 == NULL) {
-    assert(tree->quadrant_2 == NULL);
-    assert(tree->quadrant_3 == NULL);
-    assert(tree->quadrant_4 == NULL);
-
-    tree->quadrant_1 = malloc(sizeof(Quadtree));
-    *(tree->quadrant_1) = make_quadtree(N,
-      tree->p1.x + (tree->p2.x - tree->p1.x)/2,
-      tree->p1.y,
-      tree->p2.x,
-      tree->p1.y + (tree->p2.y - tree->p1.y)/2,
-      tree->depth+1,
-      tree
-    );
-    tree->quadrant_2 = malloc(sizeof(Quadtree));
-    *(tree->quadrant_2) = make_quadtree(N,
-      tree->p1.x,
-      tree->p1.y,
-      tree->p1.x + (tree->p2.x - tree->p1.x)/2,
-      tree->p1.y + (tree->p2.y - tree->p1.y)/2,
-      tree->depth+1,
-      tree
-    );
-    tree->quadrant_3 = malloc(sizeof(Quadtree));
-    *(tree->quadrant_3) = make_quadtree(N,
-      tree->p1.x,
-      tree->p1.y + (tree->p2.y - tree->p1.y)/2,
-      tree->p1.x + (tree->p2.x - tree->p1.x)/2,
-      tree->p2.y,
-      tree->depth+1,
-      tree
-    );
-    tree->quadrant_4 = malloc(sizeof(Quadtree));
-    *(tree->quadrant_4) = make_quadtree(N,
-      tree->p1.x + (tree->p2.x - tree->p1.x)/2,
-      tree->p1.y + (tree->p2.y - tree->p1.y)/2,
-      tree->p2.x,
-      tree->p2.y,
-      tree->depth+1,
-      tree
-    );
-
-    // reassign stuff currently in tree->line into new quadrants
-    reassign_current_to_quadrants(tree, quadtrees, numQuadtrees);
-
-    // add new quadtrees to the array
-    quadtrees[*numQuadtrees] = tree->quadrant_1;
-    *numQuadtrees += 1;
-    quadtrees[*numQuadtrees] = tree->quadrant_2;
-    *numQuadtrees += 1;
-    quadtrees[*numQuadtrees] = tree->quadrant_3;
-    *numQuadtrees += 1;
-    quadtrees[*numQuadtrees] = tree->quadrant_4;
-    *numQuadtrees += 1;
   }
 
   // check which quadrant the line fits in, if any
-  if (can_fit(l, tree->quadrant_1)) {
-    insert_line(l, tree->quadrant_1, quadtrees, numQuadtrees);
-  } else if (can_fit(l, tree->quadrant_2)) {
-    insert_line(l, tree->quadrant_2, quadtrees, numQuadtrees);
-  } else if (can_fit(l, tree->quadrant_3)) {
-    insert_line(l, tree->quadrant_3, quadtrees, numQuadtrees);
-  } else if (can_fit(l, tree->quadrant_4)) {
-    insert_line(l, tree->quadrant_4, quadtrees, numQuadtrees);
+  if (can_fit(store, l, tree->quadrant_1)) {
+    insert_line(qt, store, l, tree->quadrant_1);
+  } else if (can_fit(store, l, tree->quadrant_2)) {
+    insert_line(qt, store, l, tree->quadrant_2);
+  } else if (can_fit(store, l, tree->quadrant_3)) {
+    insert_line(qt, store, l, tree->quadrant_3);
+  } else if (can_fit(store, l, tree->quadrant_4)) {
+    insert_line(qt, store, l, tree->quadrant_4);
   } else {
-    // double node's line capacity if full
-    if (tree->numOfLines == tree->capacity) {
-      tree->lines = realloc(tree->lines, sizeof(Line *) * tree->capacity * 2);
-      assert(tree->lines);
-      tree->capacity *= 2;
+    store_line(qt, l, tree);
+  }
+}
+
+void reassign_current_to_quadrants(LineQuadtree * qt, const LineStore * store, Quadtree * tree) {
+  // the node takes a fresh lines array of the same size, and its old one,
+  // which can hold far too many lines to copy onto the stack, is freed once
+  // its lines have been inserted again
+  unsigned int * allLines = tree->lines;
+  unsigned int current_numOfLines = tree->numOfLines;
+  unsigned int current_capacity = tree->capacity;
+  tree->lines = alloc_bucket(qt, bucket_class(qt, current_capacity));
+  tree->numOfLines = 0;
+  for (unsigned int i = 0; i < current_numOfLines; i++) {
+    insert_line(qt, store, allLines[i], tree);
+  }
+  free_bucket(qt, allLines, current_capacity);
+}
+
+// A node of the level being built by build_LineQuadtree(), and the lines
+// that reach it, in ID order, at seq[start] to seq[start + count - 1]
+typedef struct {
+  Quadtree * tree;
+  unsigned int start;
+  unsigned int count;
+  // number of lines that had reached the node when it split, or 0 if it
+  // stays a leaf
+  unsigned int splitAt;
+  // lines that go to each quadrant (0 to 3) or stay in the node (4)
+  unsigned int groupCount[5];
+  // index of the node's first child in the next level
+  unsigned int firstChild;
+} BuildNode;
+
+// Replay the serial insertion of the node's lines, which arrive in ID order,
+// to find out whether and when it splits.  group holds each line's quadrant.
+static void decide_split(const LineQuadtree * qt, BuildNode * node, const unsigned char * group) {
+  Quadtree * tree = node->tree;
+  node->splitAt = 0;
+  for (int g = 0; g < 5; g++) {
+    node->groupCount[g] = 0;
+  }
+  if (tree->depth >= qt->params.maxDepth) {
+    return;
+  }
+
+  double in_quadrant[4] = { 0, 0, 0, 0 };
+  double straddling = 0;
+  for (unsigned int c = 1; c <= node->count; c++) {
+    unsigned int g = group[node->start + c - 1];
+    node->groupCount[g]++;
+    if (node->splitAt != 0) {
+      continue;
+    }
+    if (g < 4) {
+      in_quadrant[g]++;
+    } else {
+      straddling++;
+    }
+    if (c > tree->splitThreshold) {
+      if (split_pays_off(in_quadrant, straddling, c)) {
+        node->splitAt = c;
+      } else {
+        tree->splitThreshold = 2 * c;
+      }
     }
-    tree->lines[tree->numOfLines++] = l;
   }
 }
 
-void reassign_current_to_quadrants(Quadtree * tree, Quadtree ** quadtrees, int * numQuadtrees) {
-  int current_numOfLines = tree->numOfLines;
-  Line* allLines[current_numOfLines];
-  for (int i = 0; i < tree->numOfLines; i++) {
-    allLines[i] = tree->lines[i];
-    tree->lines[i] = NULL;
+// Give tree the smallest lines array that the serial insertion would have
+// grown it to after holding up to maxLines lines
+static void size_bucket(LineQuadtree * qt, Quadtree * tree, unsigned int maxLines) {
+  unsigned int capacity = qt->params.leafCapacity;
+  while (capacity < maxLines) {
+    capacity *= 2;
   }
-  tree->numOfLines = 0;
-  for (int i = 0; i < current_numOfLines; i++) {
-    insert_line(allLines[i], tree, quadtrees, numQuadtrees);
+  if (capacity != tree->capacity) {
+    free_bucket(qt, tree->lines, tree->capacity);
+    tree->lines = alloc_bucket(qt, bucket_class(qt, capacity));
+    tree->capacity = capacity;
   }
 }
 
-// Check if line can fit inside a given Quadtree's boundaries
-inline bool can_fit(Line * line, Quadtree * tree) {
+// State shared by the parallel loops of build_LineQuadtree() while it works
+// on one level.  seq holds the lines reaching each node of level, group the
+// quadrant each fits, and nextSeq the lines reaching each node of next.
+typedef struct {
+  LineQuadtree * qt;
+  const LineStore * store;
+  BuildNode * level;
+  const BuildNode * next;
+  const unsigned int * seq;
+  unsigned char * group;
+  unsigned int * nextSeq;
+} BuildLevel;
+
+// Work on one node of a level, or on one range of its lines
+typedef struct {
+  const BuildLevel * build;
+  const BuildNode * node;
+  Vec p1[4];
+  Vec p2[4];
+  unsigned int blockSize;
+  // counts[b][g] is first the number of block b's lines in group g, and
+  // then where block b's next such line goes
+  unsigned int (*counts)[5];
+} BuildNodeWork;
+
+static void find_quadrants(void * context, unsigned int begin, unsigned int end) {
+  BuildNodeWork * work = context;
+  const BuildNode * node = work->node;
+  const BuildLevel * build = work->build;
+  for (unsigned int i = node->start + begin; i < node->start + end; i++) {
+    build->group[i] = quadrant_of(build->store, build->seq[i], work->p1, work->p2);
+  }
+}
+
+// Find the quadrant each line of the nodes fits, then whether each splits
+static void classify_nodes(void * context, unsigned int begin, unsigned int end) {
+  BuildLevel * build = context;
+  for (unsigned int i = begin; i < end; i++) {
+    BuildNode * node = &build->level[i];
+    if (node->tree->depth < build->qt->params.maxDepth) {
+      BuildNodeWork work = { .build = build, .node = node };
+      for (int q = 0; q < 4; q++) {
+        quadrant_bounds(node->tree, q + 1, &work.p1[q], &work.p2[q]);
+      }
+      Parallel_for(node->count, QUADTREE_BUILD_LINE_GRAIN, find_quadrants, &work);
+    }
+    decide_split(build->qt, node, build->group);
+  }
+}
+
+static void keep_lines(void * context, unsigned int begin, unsigned int end) {
+  BuildNodeWork * work = context;
+  LineQuadtree * qt = work->build->qt;
+  Quadtree * tree = work->node->tree;
+  const unsigned int * lines = work->build->seq + work->node->start;
+  for (unsigned int i = begin; i < end; i++) {
+    tree->lines[i] = lines[i];
+    qt->lineNode[lines[i]] = tree;
+    qt->lineSlot[lines[i]] = i;
+  }
+}
+
+static void count_groups(void * context, unsigned int begin, unsigned int end) {
+  BuildNodeWork * work = context;
+  const BuildNode * node = work->node;
+  const unsigned char * group = work->build->group + node->start;
+  for (unsigned int b = begin; b < end; b++) {
+    unsigned int * count = work->counts[b];
+    for (int g = 0; g < 5; g++) {
+      count[g] = 0;
+    }
+    unsigned int blockEnd = MIN(node->count, (b + 1) * work->blockSize);
+    for (unsigned int i = b * work->blockSize; i < blockEnd; i++) {
+      count[group[i]]++;
+    }
+  }
+}
+
+static void scatter_groups(void * context, unsigned int begin, unsigned int end) {
+  BuildNodeWork * work = context;
+  LineQuadtree * qt = work->build->qt;
+  const BuildNode * node = work->node;
+  Quadtree * tree = node->tree;
+  const unsigned int * lines = work->build->seq + node->start;
+  const unsigned char * group = work->build->group + node->start;
+  for (unsigned int b = begin; b < end; b++) {
+    unsigned int * slot = work->counts[b];
+    unsigned int blockEnd = MIN(node->count, (b + 1) * work->blockSize);
+    for (unsigned int i = b * work->blockSize; i < blockEnd; i++) {
+      unsigned int l = lines[i];
+      unsigned int g = group[i];
+      if (g < 4) {
+        work->build->nextSeq[slot[g]++] = l;
+      } else {
+        tree->lines[slot[4]] = l;
+        qt->lineNode[l] = tree;
+        qt->lineSlot[l] = slot[4]++;
+      }
+    }
+  }
+}
+
+// Hand out each node's lines: those that stay go into its lines array, and
+// those that fit a quadrant go to that child's segment of nextSeq, keeping
+// ID order in both.  Large nodes are split into blocks handled in parallel.
+static void distribute_lines(void * context, unsigned int begin, unsigned int end) {
+  BuildLevel * build = context;
+  for (unsigned int i = begin; i < end; i++) {
+    const BuildNode * node = &build->level[i];
+    BuildNodeWork work = { .build = build, .node = node };
+    if (node->splitAt == 0) {
+      Parallel_for(node->count, QUADTREE_BUILD_LINE_GRAIN, keep_lines, &work);
+      continue;
+    }
+
+    unsigned int numBlocks = node->count / QUADTREE_BUILD_MIN_BLOCK;
+    numBlocks = MIN(numBlocks, 4 * Parallel_getNumWorkers());
+    numBlocks = MIN(numBlocks, QUADTREE_BUILD_MAX_BLOCKS);
+    numBlocks = MAX(numBlocks, 1);
+    unsigned int counts[QUADTREE_BUILD_MAX_BLOCKS][5];
+    work.blockSize = (node->count + numBlocks - 1) / numBlocks;
+    work.counts = counts;
+
+    Parallel_for(numBlocks, 1, count_groups, &work);
+    for (int g = 0; g < 5; g++) {
+      unsigned int offset = g < 4 ? build->next[node->firstChild + g].start : 0;
+      for (unsigned int b = 0; b < numBlocks; b++) {
+        unsigned int count = counts[b][g];
+        counts[b][g] = offset;
+        offset += count;
+      }
+    }
+    Parallel_for(numBlocks, 1, scatter_groups, &work);
+  }
+}
+
+// Insert the tree's members into the tree holding only the root, a level at
+// a time.  For each node of a level, the quadrant each of its lines fits is
+// found in parallel, the serial insertion is replayed to decide whether the
+// node splits, and its lines are then partitioned among itself and its
+// children.  The scratch arrays come from the tree's arena, so a rebuild
+// calls malloc only if the arena has to grow.
+static void build_LineQuadtree(LineQuadtree * qt, const LineStore * store) {
+  unsigned int n = qt->numMembers;
+  unsigned int * seq = Arena_alloc(qt->arena, sizeof(unsigned int) * MAX(n, 1));
+  unsigned int * nextSeq = Arena_alloc(qt->arena, sizeof(unsigned int) * MAX(n, 1));
+  unsigned char * group = Arena_alloc(qt->arena, MAX(n, 1));
+  BuildNode * level = Arena_alloc(qt->arena, sizeof(BuildNode));
+
+  memcpy(seq, qt->members, sizeof(unsigned int) * n);
+  level[0] = (BuildNode) { .tree = qt->root, .start = 0, .count = n };
+  unsigned int numNodes = 1;
+
+  while (numNodes > 0) {
+    BuildLevel build = {
+      .qt = qt, .store = store, .level = level, .seq = seq, .group = group,
+      .nextSeq = nextSeq
+    };
+    Parallel_for(numNodes, 1, classify_nodes, &build);
+
+    // Make the children, laying their lines out one after another in
+    // nextSeq, and size each node's lines array for the lines it keeps.
+    unsigned int numChildren = 0;
+    for (unsigned int i = 0; i < numNodes; i++) {
+      numChildren += level[i].splitAt != 0 ? 4 : 0;
+    }
+    BuildNode * next = Arena_alloc(qt->arena, sizeof(BuildNode) * MAX(numChildren, 1));
+    unsigned int numNext = 0;
+    unsigned int offset = 0;
+    for (unsigned int i = 0; i < numNodes; i++) {
+      BuildNode * node = &level[i];
+      Quadtree * tree = node->tree;
+      if (node->splitAt == 0) {
+        size_bucket(qt, tree, node->count);
+        tree->numOfLines = node->count;
+        continue;
+      }
+
+      Quadtree * children[4];
+      node->firstChild = numNext;
+      for (int q = 0; q < 4; q++) {
+        Vec p1;
+        Vec p2;
+        quadrant_bounds(tree, q + 1, &p1, &p2);
+        children[q] = make_quadtree(qt, p1.x, p1.y, p2.x, p2.y, tree->depth+1, tree);
+        next[numNext++] = (BuildNode) {
+          .tree = children[q], .start = offset, .count = node->groupCount[q]
+        };
+        offset += node->groupCount[q];
+      }
+      tree->quadrant_1 = children[0];
+      tree->quadrant_2 = children[1];
+      tree->quadrant_3 = children[2];
+      tree->quadrant_4 = children[3];
+      append_quadtrees(qt, children);
+      size_bucket(qt, tree, MAX(node->splitAt, node->groupCount[4]));
+      tree->numOfLines = node->groupCount[4];
+    }
+
+    build.next = next;
+    Parallel_for(numNodes, 1, distribute_lines, &build);
+
+    unsigned int * temp = seq;
+    seq = nextSeq;
+    nextSeq = temp;
+    level = next;
+    numNodes = numNext;
+  }
+}
+
+#ifndef NDEBUG
+// Whether the subtrees are the same: the same nodes, holding the same lines
+// in the same order, with the same lines array sizes and split thresholds
+static bool same_subtree(const Quadtree * a, const Quadtree * b) {
+  if (a->numOfLines != b->numOfLines || a->capacity != b->capacity
+      || a->splitThreshold != b->splitThreshold || a->depth != b->depth
+      || (a->quadrant_1 == NULL) != (b->quadrant_1 == NULL)) {
+    return false;
+  }
+  if (memcmp(a->lines, b->lines, sizeof(unsigned int) * a->numOfLines) != 0) {
+    return false;
+  }
+  return a->quadrant_1 == NULL ||
+    (same_subtree(a->quadrant_1, b->quadrant_1) && same_subtree(a->quadrant_2, b->quadrant_2) &&
+     same_subtree(a->quadrant_3, b->quadrant_3) && same_subtree(a->quadrant_4, b->quadrant_4));
+}
+#endif
+
+// Build a LineQuadtree holding the lines listed, or every line in the store
+void init_LineQuadtree(LineQuadtree * qt, const LineStore * store, const unsigned int * lines,
+  unsigned int numLines, QuadtreeParams params, Arena * arena) {
+  make_LineQuadtree(qt, store, params, arena);
+  if (lines == NULL) {
+    numLines = store->numOfLines;
+    for (unsigned int l = 0; l < numLines; l++) {
+      qt->members[l] = l;
+    }
+  } else {
+    memcpy(qt->members, lines, sizeof(unsigned int) * numLines);
+  }
+  qt->numMembers = numLines;
+  build_LineQuadtree(qt, store);
+
+#ifndef NDEBUG
+  // check against inserting the lines one at a time
+  Arena serialArena = Arena_make(ARENA_DEFAULT_CHUNK_SIZE);
+  LineQuadtree serial;
+  make_LineQuadtree(&serial, store, params, &serialArena);
+  for (unsigned int i = 0; i < qt->numMembers; i++) {
+    insert_line(&serial, store, qt->members[i], serial.root);
+  }
+  assert(same_subtree(qt->root, serial.root));
+  assert(qt->numQuadtrees == serial.numQuadtrees);
+  Arena_destroy(&serialArena);
+#endif
+}
+
+// Check if line's swept bounding box lies inside the box from p1 to p2
+inline bool can_fit_bounds(const LineStore * store, unsigned int line, Vec p1, Vec p2) {
+  Vec top_left = store->top_left[line];
+  Vec bottom_right = store->bottom_right[line];
+  Vec velocity = store->velocity[line];
   return
     // check line at beginning of time step
-    line->top_left.x >= tree->p1.x &&
-    line->bottom_right.x < tree->p2.x &&
-    line->top_left.y >= tree->p1.y &&
-    line->bottom_right.y < tree->p2.y &&
+    top_left.x >= p1.x &&
+    bottom_right.x < p2.x &&
+    top_left.y >= p1.y &&
+    bottom_right.y < p2.y &&
     // check line at end of time step
-    line->top_left.x + line->velocity.x >= tree->p1.x &&
-    line->bottom_right.x + line->velocity.x < tree->p2.x &&
-    line->top_left.y + line->velocity.y >= tree->p1.y &&
-    line->bottom_right.y + line->velocity.y < tree->p2.y;
+    top_left.x + velocity.x >= p1.x &&
+    bottom_right.x + velocity.x < p2.x &&
+    top_left.y + velocity.y >= p1.y &&
+    bottom_right.y + velocity.y < p2.y;
+}
+
+// Check if line can fit inside a given Quadtree's boundaries
+inline bool can_fit(const LineStore * store, unsigned int line, Quadtree * tree) {
+  return can_fit_bounds(store, line, tree->p1, tree->p2);
 }
 
-// Recursively deletes all Quadtrees in this subtree
-void delete_Quadtree(Quadtree * tree) {
+// Recursively returns all Quadtrees in this subtree to qt's free lists
+void delete_Quadtree(LineQuadtree * qt, Quadtree * tree) {
   if (tree->quadrant_1) {
     assert(tree->quadrant_2);
     assert(tree->quadrant_3);
     assert(tree->quadrant_4);
 
     // delete child quadtrees
-    delete_Quadtree(tree->quadrant_1);
-    delete_Quadtree(tree->quadrant_2);
-    delete_Quadtree(tree->quadrant_3);
-    delete_Quadtree(tree->quadrant_4);
+    delete_Quadtree(qt, tree->quadrant_1);
+    delete_Quadtree(qt, tree->quadrant_2);
+    delete_Quadtree(qt, tree->quadrant_3);
+    delete_Quadtree(qt, tree->quadrant_4);
     tree->quadrant_1 = tree->quadrant_2 = tree->quadrant_3 = tree->quadrant_4 = NULL;
   }
 
@@ -170,58 +639,555 @@ void delete_Quadtree(Quadtree * tree) {
   assert(tree->quadrant_4 == NULL);
 
   // delete itself
-  free(tree->lines);
-  free(tree);
-}
-
-// Check for collisions all quadtrees
-void detect_collisions(IntersectionEventList_reducer * reducer, Quadtree ** quadtrees, int * numQuadtrees) {
-  cilk_for (int k = 0; k < *numQuadtrees; k++) {
-    Quadtree * current_tree = quadtrees[k];
-
-    // check all pairs of lines in the current quadtree node
-    cilk_for (int i = 0; i < current_tree->numOfLines; i++) {
-      for (int j = i + 1; j < current_tree->numOfLines; j++) {
-        Line * l1 = current_tree->lines[i];
-        Line * l2 = current_tree->lines[j];
-
-        if (compareLines(l1, l2) > 0) {
-          Line *temp = l1;
-          l1 = l2;
-          l2 = temp;
-        }
-
-        IntersectionType intersectionType = intersect(l1, l2);
-        if (intersectionType != NO_INTERSECTION) {
-          IntersectionEventList_appendNode(&REDUCER_VIEW(*reducer), l1, l2, intersectionType);
-        }
+  free_bucket(qt, tree->lines, tree->capacity);
+  tree->quadrant_1 = qt->freeNodes;
+  qt->freeNodes = tree;
+}
+
+// Whether l belongs somewhere other than tree: either its swept box has left
+// tree, or it now fits inside one of tree's quadrants.  The root holds every
+// line that fits nowhere else.
+static inline bool needs_move(const LineStore * store, unsigned int l, Quadtree * tree) {
+  if (tree->parent != NULL && !can_fit(store, l, tree)) {
+    return true;
+  }
+  return tree->quadrant_1 != NULL &&
+    (can_fit(store, l, tree->quadrant_1) || can_fit(store, l, tree->quadrant_2) ||
+     can_fit(store, l, tree->quadrant_3) || can_fit(store, l, tree->quadrant_4));
+}
+
+// Collapses subtrees that hold at most leafCapacity / 2 lines back into their
+// root, so the tree shrinks again as lines spread out.  Returns the number of
+// lines in the subtree.
+static unsigned int merge_sparse_subtrees(LineQuadtree * qt, Quadtree * tree) {
+  if (tree->quadrant_1 == NULL) {
+    return tree->numOfLines;
+  }
+
+  unsigned int total = tree->numOfLines
+    + merge_sparse_subtrees(qt, tree->quadrant_1)
+    + merge_sparse_subtrees(qt, tree->quadrant_2)
+    + merge_sparse_subtrees(qt, tree->quadrant_3)
+    + merge_sparse_subtrees(qt, tree->quadrant_4);
+  if (total > qt->params.leafCapacity / 2) {
+    return total;
+  }
+
+  // every child holds at most leafCapacity / 2 lines too, so each has
+  // already been collapsed into a leaf
+  Quadtree * children[4] = {
+    tree->quadrant_1, tree->quadrant_2, tree->quadrant_3, tree->quadrant_4
+  };
+  for (int c = 0; c < 4; c++) {
+    assert(children[c]->quadrant_1 == NULL);
+    for (unsigned int i = 0; i < children[c]->numOfLines; i++) {
+      store_line(qt, children[c]->lines[i], tree);
+    }
+    delete_Quadtree(qt, children[c]);
+  }
+  tree->quadrant_1 = tree->quadrant_2 = tree->quadrant_3 = tree->quadrant_4 = NULL;
+  tree->splitThreshold = qt->params.leafCapacity;
+  qt->nodesChanged = true;
+  return total;
+}
+
+// Appends every node of the subtree to qt->quadtrees, parents first
+static void collect_quadtrees(LineQuadtree * qt, Quadtree * tree) {
+  qt->quadtrees[qt->numQuadtrees++] = tree;
+  if (tree->quadrant_1) {
+    collect_quadtrees(qt, tree->quadrant_1);
+    collect_quadtrees(qt, tree->quadrant_2);
+    collect_quadtrees(qt, tree->quadrant_3);
+    collect_quadtrees(qt, tree->quadrant_4);
+  }
+}
+
+typedef struct {
+  LineQuadtree * qt;
+  const LineStore * store;
+} UpdateContext;
+
+static void find_moves(void * context, unsigned int begin, unsigned int end) {
+  UpdateContext * c = context;
+  for (unsigned int i = begin; i < end; i++) {
+    unsigned int l = c->qt->members[i];
+    c->qt->lineMoves[l] = needs_move(c->store, l, c->qt->lineNode[l]);
+  }
+}
+
+// Bring the LineQuadtree up to date with the lines' current positions and
+// velocities
+void update_LineQuadtree(LineQuadtree * qt, const LineStore * store) {
+  assert(qt->numOfLines == store->numOfLines);
+
+  // Find the lines that need moving in parallel.  Moving other lines can
+  // only settle a line in the right node, never unsettle one, so lines not
+  // found here can be skipped; those found are checked again when their turn
+  // comes, in ID order as before.
+  UpdateContext context = { .qt = qt, .store = store };
+  Parallel_for(qt->numMembers, QUADTREE_BUILD_LINE_GRAIN, find_moves, &context);
+
+  for (unsigned int i = 0; i < qt->numMembers; i++) {
+    unsigned int l = qt->members[i];
+    Quadtree * tree = qt->lineNode[l];
+    if (!qt->lineMoves[l] || !needs_move(store, l, tree)) {
+      continue;
+    }
+    remove_line(qt, l);
+
+    // climb to the closest ancestor that still contains the line, then
+    // push it back down as far as it goes
+    while (tree->parent != NULL && !can_fit(store, l, tree)) {
+      tree = tree->parent;
+    }
+    insert_line(qt, store, l, tree);
+  }
+
+  merge_sparse_subtrees(qt, qt->root);
+  if (qt->nodesChanged) {
+    qt->numQuadtrees = 0;
+    collect_quadtrees(qt, qt->root);
+    qt->nodesChanged = false;
+  }
+}
+
+// Index of the first member not below l
+static unsigned int member_index(const LineQuadtree * qt, unsigned int l) {
+  unsigned int lo = 0;
+  unsigned int hi = qt->numMembers;
+  while (lo < hi) {
+    unsigned int mid = lo + (hi - lo) / 2;
+    if (qt->members[mid] < l) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// Add l to the members, keeping them in ID order, and insert it from the root
+void add_line_LineQuadtree(LineQuadtree * qt, const LineStore * store, unsigned int l) {
+  assert(qt->lineNode[l] == NULL);
+  unsigned int i = member_index(qt, l);
+  memmove(&qt->members[i + 1], &qt->members[i], sizeof(unsigned int) * (qt->numMembers - i));
+  qt->members[i] = l;
+  qt->numMembers++;
+  insert_line(qt, store, l, qt->root);
+}
+
+// Take l out of its node and out of the members.  Nodes left sparse are
+// merged by the next update, if any.
+void remove_line_LineQuadtree(LineQuadtree * qt, unsigned int l) {
+  assert(qt->lineNode[l] != NULL);
+  remove_line(qt, l);
+  unsigned int i = member_index(qt, l);
+  assert(qt->members[i] == l);
+  qt->numMembers--;
+  memmove(&qt->members[i], &qt->members[i + 1], sizeof(unsigned int) * (qt->numMembers - i));
+}
+
+// Release every node of the LineQuadtree and its bookkeeping arrays, all of
+// which live in its arena
+void destroy_LineQuadtree(LineQuadtree * qt) {
+  Arena_reset(qt->arena);
+  qt->root = NULL;
+  qt->quadtrees = NULL;
+  qt->numQuadtrees = 0;
+}
+
+// Whether line's swept box reaches the closed box from p1 to p2.  A node's
+// lines lie inside it, so a line whose swept box misses a node's bounds
+// misses every line of the node, and intersect() would reject each pair.
+static inline bool reaches_bounds(const LineStore * store, unsigned int line, Vec p1, Vec p2) {
+  Vec top_left = store->top_left[line];
+  Vec bottom_right = store->bottom_right[line];
+  Vec velocity = store->velocity[line];
+  return MIN(top_left.x, top_left.x + velocity.x) <= p2.x &&
+    MAX(bottom_right.x, bottom_right.x + velocity.x) >= p1.x &&
+    MIN(top_left.y, top_left.y + velocity.y) <= p2.y &&
+    MAX(bottom_right.y, bottom_right.y + velocity.y) >= p1.y;
+}
+
+// A node, and the lines of its ancestors whose swept boxes reach its
+// bounds, the only ones its lines need testing against.  Nodes are listed
+// a level at a time, and parent is the position of the node's parent.
+typedef struct {
+  const Quadtree * tree;
+  unsigned int parent;
+  unsigned int * reach;
+  unsigned int numReach;
+} ReachNode;
+
+// Store in reach, unless it is NULL, the lines reaching tree's bounds among
+// those reaching its parent's and those its parent holds, and count them.
+// A line that misses the parent's bounds misses tree's too.
+static unsigned int find_reach(const LineStore * store, const ReachNode * parent,
+  const Quadtree * tree, unsigned int * reach) {
+  unsigned int count = 0;
+  for (unsigned int i = 0; i < parent->numReach; i++) {
+    unsigned int l = parent->reach[i];
+    if (reaches_bounds(store, l, tree->p1, tree->p2)) {
+      if (reach != NULL) {
+        reach[count] = l;
+      }
+      count++;
+    }
+  }
+  for (unsigned int i = 0; i < parent->tree->numOfLines; i++) {
+    unsigned int l = parent->tree->lines[i];
+    if (reaches_bounds(store, l, tree->p1, tree->p2)) {
+      if (reach != NULL) {
+        reach[count] = l;
       }
+      count++;
+    }
+  }
+  return count;
+}
+
+// One level of nodes, starting at nodes[first], whose lines reaching them
+// are counted into numReach, or, once reach is set, stored into reach
+typedef struct {
+  const LineStore * store;
+  ReachNode * nodes;
+  unsigned int first;
+  bool counted;
+} ReachContext;
+
+static void reach_nodes(void * context, unsigned int begin, unsigned int end) {
+  ReachContext * c = context;
+  for (unsigned int k = c->first + begin; k < c->first + end; k++) {
+    ReachNode * node = &c->nodes[k];
+    const ReachNode * parent = &c->nodes[node->parent];
+    if (!c->counted) {
+      node->numReach = find_reach(c->store, parent, node->tree, NULL);
+    } else {
+      unsigned int count = find_reach(c->store, parent, node->tree, node->reach);
+      assert(count == node->numReach);
+      (void) count;
+    }
+  }
+}
+
+// List the numNodes nodes of the tree under root a level at a time, and find
+// the lines reaching each from those reaching the level above, counting them
+// and then storing them in parallel
+static ReachNode * list_reach(const LineStore * store, const Quadtree * root, int numNodes,
+  Arena * scratch) {
+  ReachNode * nodes = Arena_alloc(scratch, sizeof(ReachNode) * numNodes);
+  nodes[0] = (ReachNode) { .tree = root, .parent = 0, .reach = NULL, .numReach = 0 };
+  unsigned int count = 1;
+  for (unsigned int k = 0; k < count; k++) {
+    const Quadtree * tree = nodes[k].tree;
+    if (tree->quadrant_1 == NULL) {
+      continue;
+    }
+    const Quadtree * children[4] = {
+      tree->quadrant_1, tree->quadrant_2, tree->quadrant_3, tree->quadrant_4
+    };
+    for (int q = 0; q < 4; q++) {
+      assert(count < (unsigned int) numNodes);
+      nodes[count++] = (ReachNode) { .tree = children[q], .parent = k };
+    }
+  }
+  assert(count == (unsigned int) numNodes);
+
+  unsigned int first = 1;
+  while (first < count) {
+    unsigned int end = first;
+    while (end < count && nodes[end].tree->depth == nodes[first].tree->depth) {
+      end++;
+    }
+    ReachContext context = {
+      .store = store, .nodes = nodes, .first = first, .counted = false
+    };
+    Parallel_for(end - first, QUADTREE_NODE_GRAIN, reach_nodes, &context);
+    unsigned int total = 0;
+    for (unsigned int k = first; k < end; k++) {
+      total += nodes[k].numReach;
+    }
+    unsigned int * reach = Arena_alloc(scratch, sizeof(unsigned int) * MAX(total, 1));
+    for (unsigned int k = first; k < end; k++) {
+      nodes[k].reach = reach;
+      reach += nodes[k].numReach;
+    }
+    context.counted = true;
+    Parallel_for(end - first, QUADTREE_NODE_GRAIN, reach_nodes, &context);
+    first = end;
+  }
+  return nodes;
+}
+
+// A tile of pair tests: each line rows[i], for i from rowStart up to rowEnd,
+// against cols[colStart] up to cols[colEnd], or against the lines after it
+// when cols is rows
+typedef struct {
+  const unsigned int * rows;
+  const unsigned int * cols;
+  unsigned int rowStart;
+  unsigned int rowEnd;
+  unsigned int colStart;
+  unsigned int colEnd;
+  unsigned long cost;
+} PairTask;
+
+// Store task at tasks[*numTasks] unless tasks is NULL, and count it
+static inline void add_task(PairTask * tasks, unsigned int * numTasks, PairTask task) {
+  if (tasks != NULL) {
+    tasks[*numTasks] = task;
+  }
+  (*numTasks)++;
+}
+
+// Cut the pairs of lines within tree into tiles of consecutive rows, each
+// of about QUADTREE_TILE_PAIRS pairs
+static void tile_node(const Quadtree * tree, PairTask * tasks, unsigned int * numTasks) {
+  unsigned int n = tree->numOfLines;
+  unsigned int start = 0;
+  unsigned long cost = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    cost += n - 1 - i;
+    if (cost >= QUADTREE_TILE_PAIRS || (i == n - 1 && cost > 0)) {
+      add_task(tasks, numTasks, (PairTask) {
+        .rows = tree->lines, .cols = tree->lines, .rowStart = start, .rowEnd = i + 1,
+        .colStart = 0, .colEnd = n, .cost = cost
+      });
+      start = i + 1;
+      cost = 0;
     }
+  }
+}
 
-    // check all lines in the current quadtree node against all lines in all parent quadtree nodes
-    cilk_for (int i = 0; i < current_tree->depth; i++) {
-      Quadtree * checking = current_tree->parent;
-      for (int j = 0; j < i; j++) {
-        checking = checking->parent;
+// Cut the pairs between the m lines reaching tree and those of tree into
+// tiles of about QUADTREE_TILE_PAIRS pairs, splitting tree's lines too when
+// one reaching line would already have more
+static void tile_reach(const unsigned int * reach, unsigned int m, const Quadtree * tree,
+  PairTask * tasks, unsigned int * numTasks) {
+  unsigned int n = tree->numOfLines;
+  if (m == 0 || n == 0) {
+    return;
+  }
+  if (n >= QUADTREE_TILE_PAIRS) {
+    for (unsigned int r = 0; r < m; r++) {
+      for (unsigned int c = 0; c < n; c += QUADTREE_TILE_PAIRS) {
+        unsigned int end = MIN(n, c + QUADTREE_TILE_PAIRS);
+        add_task(tasks, numTasks, (PairTask) {
+          .rows = reach, .cols = tree->lines, .rowStart = r, .rowEnd = r + 1,
+          .colStart = c, .colEnd = end, .cost = end - c
+        });
       }
+    }
+    return;
+  }
+  unsigned int rowsPerTile = QUADTREE_TILE_PAIRS / n;
+  for (unsigned int r = 0; r < m; r += rowsPerTile) {
+    unsigned int end = MIN(m, r + rowsPerTile);
+    add_task(tasks, numTasks, (PairTask) {
+      .rows = reach, .cols = tree->lines, .rowStart = r, .rowEnd = end,
+      .colStart = 0, .colEnd = n, .cost = (unsigned long) (end - r) * n
+    });
+  }
+}
 
-      cilk_for (int check_source_index = 0; check_source_index < checking->numOfLines; check_source_index++) {
-        for (int tree_index = 0; tree_index < current_tree->numOfLines; tree_index++) {
-          Line * l1 = current_tree->lines[tree_index];
-          Line * l2 = checking->lines[check_source_index];
-
-          if (compareLines(l1, l2) > 0) {
-            Line *temp = l1;
-            l1 = l2;
-            l2 = temp;
-          }
-
-          IntersectionType intersectionType = intersect(l1, l2);
-          if (intersectionType != NO_INTERSECTION) {
-            IntersectionEventList_appendNode(&REDUCER_VIEW(*reducer), l1, l2, intersectionType);
-          }
-        }
+// Cut the pairs node is responsible for, those within it and those between
+// it and the lines of its ancestors reaching it, into tiles
+static void tile_pairs(const ReachNode * node, PairTask * tasks, unsigned int * numTasks) {
+  tile_node(node->tree, tasks, numTasks);
+  tile_reach(node->reach, node->numReach, node->tree, tasks, numTasks);
+}
+
+// Test the pairs of one tile
+static void run_task(IntersectionEventList * events, const LineStore * store,
+  const PairTask * task) {
+  STATS_ADD(task->rows == task->cols ? STAT_PAIRS_SAME_NODE : STAT_PAIRS_ANCESTOR, task->cost);
+  const unsigned int * cols = task->cols;
+  for (unsigned int i = task->rowStart; i < task->rowEnd; i++) {
+    unsigned int l1 = task->rows[i];
+    unsigned int start = task->rows == task->cols ? i + 1 : task->colStart;
+    for (unsigned int j = start; j < task->colEnd; j += INTERSECT_BATCH_SIZE) {
+      unsigned int count = MIN(INTERSECT_BATCH_SIZE, task->colEnd - j);
+      IntersectionType types[INTERSECT_BATCH_SIZE];
+      unsigned int hits = intersectBatch(store, l1, &cols[j], count, types);
+      if (hits) {
+        IntersectionEventList_appendHits(events, l1, &cols[j], hits, types);
       }
     }
   }
 }
+
+// Nodes whose tiles are counted into firstTask, or, once tasks is set,
+// stored into tasks starting at firstTask
+typedef struct {
+  const ReachNode * nodes;
+  unsigned int * firstTask;
+  PairTask * tasks;
+} TileContext;
+
+static void tile_nodes(void * context, unsigned int begin, unsigned int end) {
+  TileContext * c = context;
+  for (unsigned int k = begin; k < end; k++) {
+    if (c->tasks == NULL) {
+      unsigned int count = 0;
+      tile_pairs(&c->nodes[k], NULL, &count);
+      c->firstTask[k] = count;
+    } else {
+      unsigned int next = c->firstTask[k];
+      tile_pairs(&c->nodes[k], c->tasks, &next);
+      assert(next == c->firstTask[k + 1]);
+    }
+  }
+}
+
+typedef struct {
+  IntersectionEventList * events;
+  const LineStore * store;
+  const PairTask * tasks;
+} RunContext;
+
+static void run_tasks(void * context, unsigned int begin, unsigned int end) {
+  RunContext * c = context;
+  for (unsigned int t = begin; t < end; t++) {
+    run_task(c->events, c->store, &c->tasks[t]);
+  }
+}
+
+// Check for collisions all quadtrees.  Each node's lines are tested against
+// only the lines of its ancestors that reach its bounds, so a line held high
+// up for crossing a boundary is tested against the nodes along its path
+// rather than against the whole subtree.  The pairs to test are then listed
+// as tiles of bounded cost, so that a node holding many lines, or reached by
+// many, is spread over many workers, and the tiles are run most expensive
+// first.
+unsigned long detect_collisions(IntersectionEventList * events, const LineStore * store,
+  Quadtree ** quadtrees, int * numQuadtrees, Arena * scratch) {
+  int numNodes = *numQuadtrees;
+  assert(quadtrees[0]->parent == NULL);
+  const ReachNode * nodes = list_reach(store, quadtrees[0], numNodes, scratch);
+
+  // count each node's tiles, then lay them out one node after another
+  TileContext context = {
+    .nodes = nodes,
+    .firstTask = Arena_alloc(scratch, sizeof(unsigned int) * (numNodes + 1)),
+    .tasks = NULL
+  };
+  Parallel_for(numNodes, QUADTREE_NODE_GRAIN, tile_nodes, &context);
+  unsigned int numTasks = 0;
+  for (int k = 0; k < numNodes; k++) {
+    unsigned int count = context.firstTask[k];
+    context.firstTask[k] = numTasks;
+    numTasks += count;
+  }
+  context.firstTask[numNodes] = numTasks;
+
+  PairTask * tasks = Arena_alloc(scratch, sizeof(PairTask) * numTasks);
+  context.tasks = tasks;
+  Parallel_for(numNodes, QUADTREE_NODE_GRAIN, tile_nodes, &context);
+
+  // order the tiles by the leading bit of their cost, highest first, with a
+  // counting sort, and count the pairs about to be tested
+  unsigned int classStart[65] = { 0 };
+  unsigned long pairs_tested = 0;
+  for (unsigned int t = 0; t < numTasks; t++) {
+    classStart[__builtin_clzl(tasks[t].cost) + 1]++;
+    pairs_tested += tasks[t].cost;
+  }
+  for (int c = 1; c < 65; c++) {
+    classStart[c] += classStart[c - 1];
+  }
+  PairTask * ordered = Arena_alloc(scratch, sizeof(PairTask) * numTasks);
+  for (unsigned int t = 0; t < numTasks; t++) {
+    ordered[classStart[__builtin_clzl(tasks[t].cost)]++] = tasks[t];
+  }
+
+  RunContext run = { .events = events, .store = store, .tasks = ordered };
+  Parallel_for(numTasks, 1, run_tasks, &run);
+  return pairs_tested;
+}
+
+// Candidates from a static tree waiting to be tested against line l
+typedef struct {
+  IntersectionEventList * events;
+  const LineStore * store;
+  unsigned int l;
+  unsigned int candidates[INTERSECT_BATCH_SIZE];
+  unsigned int count;
+} StaticBatch;
+
+// Test the batch's candidates and empty it
+static inline void flush_static(StaticBatch * batch) {
+  IntersectionType types[INTERSECT_BATCH_SIZE];
+  unsigned int hits = intersectBatch(batch->store, batch->l, batch->candidates, batch->count,
+    types);
+  if (hits) {
+    IntersectionEventList_appendHits(batch->events, batch->l, batch->candidates, hits, types);
+  }
+  batch->count = 0;
+}
+
+// Queue the lines of tree that the swept box of the batch's line reaches,
+// then descend into the quadrants it reaches.  A static line's swept box is
+// its box, so a line it misses is one intersect() would reject, and so is
+// every line of a quadrant it misses.  Returns the pairs queued.
+static unsigned long query_static(StaticBatch * batch, const Quadtree * tree) {
+  const LineStore * store = batch->store;
+  unsigned long queued = 0;
+  for (unsigned int i = 0; i < tree->numOfLines; i++) {
+    unsigned int s = tree->lines[i];
+    if (!reaches_bounds(store, batch->l, store->top_left[s], store->bottom_right[s])) {
+      continue;
+    }
+    batch->candidates[batch->count++] = s;
+    queued++;
+    if (batch->count == INTERSECT_BATCH_SIZE) {
+      flush_static(batch);
+    }
+  }
+  if (tree->quadrant_1 == NULL) {
+    return queued;
+  }
+  const Quadtree * children[4] = {
+    tree->quadrant_1, tree->quadrant_2, tree->quadrant_3, tree->quadrant_4
+  };
+  for (int q = 0; q < 4; q++) {
+    if (reaches_bounds(store, batch->l, children[q]->p1, children[q]->p2)) {
+      queued += query_static(batch, children[q]);
+    }
+  }
+  return queued;
+}
+
+typedef struct {
+  IntersectionEventList * events;
+  const LineStore * store;
+  const LineQuadtree * statics;
+  const unsigned int * lines;
+} StaticContext;
+
+static unsigned long query_lines(void * context, unsigned int begin, unsigned int end) {
+  StaticContext * c = context;
+  const LineStore * store = c->store;
+  StaticBatch batch = {
+    .events = c->events, .store = store, .count = 0
+  };
+  unsigned long pairs_tested = 0;
+  for (unsigned int i = begin; i < end; i++) {
+    batch.l = c->lines[i];
+    pairs_tested += query_static(&batch, c->statics->root);
+    if (batch.count > 0) {
+      flush_static(&batch);
+    }
+  }
+  STATS_ADD(STAT_PAIRS_STATIC, pairs_tested);
+  return pairs_tested;
+}
+
+// Test the lines against the static tree, each line descending only into
+// the nodes its swept box reaches
+unsigned long detect_static_collisions(IntersectionEventList * events, const LineStore * store,
+  const LineQuadtree * statics, const unsigned int * lines, unsigned int numLines) {
+  StaticContext context = {
+    .events = events, .store = store, .statics = statics, .lines = lines
+  };
+  return Parallel_sum(numLines, QUADTREE_STATIC_GRAIN, query_lines, &context);
+}
@@ -1,18 +1,59 @@
+#ifndef QUADTREE_H_
+#define QUADTREE_H_
+
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "./Arena.h"
 #include "./Line.h"
 #include "./Vec.h"
-#include "./CollisionWorld.h"
 #include "./IntersectionDetection.h"
+#include "./IntersectionBatch.h"
 #include "./IntersectionEventList.h"
-#include "./IntersectionEventListReducer.h"
 
-// maximum number of items in a Quadtree before the quadtree adds its children
-#define N 64
-// max Quadtree depth
-#define MAX_DEPTH 2
+// default number of lines a leaf holds before it is considered for splitting
+#define QUADTREE_DEFAULT_LEAF_CAPACITY 64
+// default depth below which the Quadtree never splits
+#define QUADTREE_DEFAULT_MAX_DEPTH 12
+// largest maximum depth accepted on the command line
+#define QUADTREE_MAX_DEPTH 32
+// overhead of visiting one extra node, in units of pair tests, used when
+// deciding whether splitting a leaf pays off
+#define QUADTREE_NODE_COST 64
+// number of sizes a node's lines array can have: leafCapacity times each
+// power of two below this
+#define QUADTREE_BUCKET_CLASSES 32
+// fewest lines given to each block when the build partitions one node's
+// lines in parallel, and the most blocks a node's lines are split into
+#define QUADTREE_BUILD_MIN_BLOCK 4096
+#define QUADTREE_BUILD_MAX_BLOCKS 32
+// lines each worker takes at a time when the build or update visits lines
+#define QUADTREE_BUILD_LINE_GRAIN 1024
+// nodes each worker takes at a time when listing the tiles of work
+#define QUADTREE_NODE_GRAIN 16
+// pair tests in each tile of work that detect_collisions() hands out
+#define QUADTREE_TILE_PAIRS 4096
+// lines each worker takes at a time when testing lines against a static tree
+#define QUADTREE_STATIC_GRAIN 64
+
+// Limits on the shape of a LineQuadtree, set at runtime
+typedef struct {
+  // a leaf holding more lines than this is considered for splitting, and a
+  // subtree holding at most half this many is merged back into one node
+  unsigned int leafCapacity;
+  // nodes at this depth (the root has depth 0) are never split
+  unsigned int maxDepth;
+} QuadtreeParams;
+
+// Returns the default QuadtreeParams
+static inline QuadtreeParams QuadtreeParams_default() {
+  QuadtreeParams params = {
+    .leafCapacity = QUADTREE_DEFAULT_LEAF_CAPACITY,
+    .maxDepth = QUADTREE_DEFAULT_MAX_DEPTH
+  };
+  return params;
+}
 
 typedef struct Quadtree Quadtree;
 
@@ -24,33 +65,115 @@ struct Quadtree {
   Quadtree * quadrant_3;
   Quadtree * quadrant_4;
 
-  Line** lines;
+  // IDs of the lines stored in this node
+  unsigned int* lines;
   unsigned int numOfLines;
   unsigned int capacity;
   unsigned int depth;
 
+  // a leaf considers splitting once it holds more lines than this
+  unsigned int splitThreshold;
+
   // vectors representing quadtree boundaries
   Vec p1;
   Vec p2;
 };
 
-// Make new Quadtree
-Quadtree make_quadtree(unsigned int capacity, double x_lo, double y_lo,
+// A Quadtree that is kept alive across frames.  It remembers which node
+// holds each line, and where in that node's lines array, so that each frame
+// only the lines that no longer belong in their node have to be moved.
+//
+// All of its memory comes from an arena.  Nodes and lines arrays given up by
+// merges and growth are kept on free lists and reused, so once the tree has
+// reached its largest size, frames no longer allocate.
+typedef struct LineQuadtree LineQuadtree;
+
+struct LineQuadtree {
+  Quadtree * root;
+  QuadtreeParams params;
+
+  // arena the tree allocates from; reset when the tree is destroyed
+  Arena * arena;
+  // unused nodes, linked through quadrant_1
+  Quadtree * freeNodes;
+  // unused lines arrays with room for leafCapacity << k lines, linked
+  // through their first bytes, indexed by k
+  void * freeBuckets[QUADTREE_BUCKET_CLASSES];
+
+  // every node in the tree, root first
+  Quadtree ** quadtrees;
+  int numQuadtrees;
+  int quadtreesCapacity;
+
+  // node holding each line and the line's index in that node's lines array,
+  // indexed by line ID; NULL for lines the tree does not hold
+  Quadtree ** lineNode;
+  unsigned int * lineSlot;
+  unsigned int numOfLines;
+
+  // IDs of the lines the tree holds, in increasing order
+  unsigned int * members;
+  unsigned int numMembers;
+
+  // whether each line needed moving at the start of the current update
+  bool * lineMoves;
+
+  // set when a split or merge has changed the set of nodes
+  bool nodesChanged;
+};
+
+// Make new empty Quadtree, allocated from qt
+Quadtree * make_quadtree(LineQuadtree * qt, double x_lo, double y_lo,
   double x_hi, double y_hi, unsigned int depth, Quadtree * parent);
 
-// Parses the CollisionWorld into a Quadtree
-Quadtree* parse_CollisionWorld_to_Quadtree(CollisionWorld * world, Quadtree ** quadtrees, int * numQuadtrees);
+// Builds a LineQuadtree holding the numLines lines listed in increasing ID
+// order, or every line in the store if lines is NULL, allocating from arena,
+// which it takes over until it is destroyed.  The tree is built a level at a
+// time in parallel, and is the same tree that inserting the lines one at a
+// time in ID order makes.
+void init_LineQuadtree(LineQuadtree * qt, const LineStore * store, const unsigned int * lines,
+  unsigned int numLines, QuadtreeParams params, Arena * arena);
+
+// Adds line l, which the tree does not hold yet, to the tree
+void add_line_LineQuadtree(LineQuadtree * qt, const LineStore * store, unsigned int l);
+
+// Removes line l, which the tree holds, from the tree
+void remove_line_LineQuadtree(LineQuadtree * qt, unsigned int l);
+
+// Moves the lines that no longer fit their node (or now fit one of its
+// children) and merges subtrees that have become sparse
+void update_LineQuadtree(LineQuadtree * qt, const LineStore * store);
+
+// Releases every node of the LineQuadtree and its bookkeeping arrays by
+// resetting its arena
+void destroy_LineQuadtree(LineQuadtree * qt);
 
 // inserts line into Quadtree
-void insert_line(Line* l, Quadtree * tree, Quadtree ** quadtrees, int * numQuadtrees);
+void insert_line(LineQuadtree * qt, const LineStore * store, unsigned int l, Quadtree * tree);
 
 // reinserts lines currently in Quadtree back in (called after child Quadtrees are created)
-void reassign_current_to_quadrants(Quadtree * tree, Quadtree ** quadtrees, int * numQuadtrees);
+void reassign_current_to_quadrants(LineQuadtree * qt, const LineStore * store, Quadtree * tree);
+
+// check if line can fit inside the box from p1 to p2
+bool can_fit_bounds(const LineStore * store, unsigned int line, Vec p1, Vec p2);
 
 // check if line can fit inside a given Quadtree's boundaries
-bool can_fit(Line * line, Quadtree * tree);
+bool can_fit(const LineStore * store, unsigned int line, Quadtree * tree);
+
+// Recursively returns all Quadtrees in this subtree to qt's free lists
+void delete_Quadtree(LineQuadtree * qt, Quadtree * tree);
+
+// Tests every pair of lines sharing a node, and every line against the lines
+// of its node's ancestors whose swept boxes reach the node.  quadtrees lists the nodes, root first.
+// The list of work is allocated from scratch.  Returns the number of pairs
+// tested.
+unsigned long detect_collisions(IntersectionEventList * events, const LineStore * store,
+  Quadtree ** quadtrees, int * numQuadtrees, Arena * scratch);
 
-// Recursively deletes all Quadtrees in this subtree
-void delete_Quadtree(Quadtree * tree);
+// Tests each of the numLines lines listed against the lines of statics in
+// the nodes its swept box reaches.  statics is not updated, and must not
+// change meanwhile.  Returns the number of pairs tested.
+unsigned long detect_static_collisions(IntersectionEventList * events, const LineStore * store,
+  const LineQuadtree * statics, const unsigned int * lines, unsigned int numLines);
 
-void detect_collisions(IntersectionEventList_reducer * reducer, Quadtree ** quadtrees, int * numQuadtrees);
+#endif  // QUADTREE_H_
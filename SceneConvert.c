@@ -20,21 +20,28 @@
  * SOFTWARE.
  **/
 
-#ifndef INTERSECTIONEVENTLISTREDUCER_H_
-#define INTERSECTIONEVENTLISTREDUCER_H_
+// SceneConvert -- converts a scene file to the binary scene format, which
+// Screensaver loads without parsing.
 
-#include <cilk/reducer.h>
-#include "./IntersectionEventList.h"
+#include <stdio.h>
+#include <stdlib.h>
 
-// Evaluates *left = *left OPERATOR *right.
-void IntersectionEventList_reduce(void* key, void* left, void* right);
+#include "./Line.h"
+#include "./SceneFile.h"
 
-// Sets *value to the the identity value.
-void IntersectionEventList_identity(void* key, void* value);
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    printf("Usage: %s <input scene> <output scene>\n", argv[0]);
+    printf("  Reads a text or binary scene and writes it in binary format.\n");
+    exit(-1);
+  }
 
-// Destroys any dynamically allocated memory. Hint: delete_nodes.
-void IntersectionEventList_destroy(void* key, void* value);
-
-typedef CILK_C_DECLARE_REDUCER(IntersectionEventList) IntersectionEventList_reducer;
-
-#endif  // INTERSECTIONEVENTLISTREDUCER_H_
+  LineStore lines;
+  if (!SceneFile_load(argv[1], &lines)) {
+    exit(-1);
+  }
+  bool written = SceneFile_writeBinary(argv[2], &lines);
+  printf("Wrote %u lines to %s\n", lines.numOfLines, argv[2]);
+  LineStore_destroy(&lines);
+  return written ? 0 : -1;
+}
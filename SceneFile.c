@@ -0,0 +1,488 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include <assert.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "./IntersectionDetection.h"
+#include "./Parallel.h"
+#include "./SceneFile.h"
+
+// Colors are mapped straight from the file, which stores them as 32 bits.
+_Static_assert(sizeof(Color) == sizeof(uint32_t), "Color must be 32 bits");
+
+// Size in bytes of one element of each array
+static const size_t SceneFile_elementSize[SCENEFILE_NUM_ARRAYS] = {
+  [SCENEFILE_P1] = sizeof(Vec),
+  [SCENEFILE_P2] = sizeof(Vec),
+  [SCENEFILE_VELOCITY] = sizeof(Vec),
+  [SCENEFILE_RELATIVE_VECTOR] = sizeof(Vec),
+  [SCENEFILE_TOP_LEFT] = sizeof(Vec),
+  [SCENEFILE_BOTTOM_RIGHT] = sizeof(Vec),
+  [SCENEFILE_COLOR] = sizeof(Color),
+};
+
+// Returns the addresses of the arrays of store, in file order.
+static void SceneFile_arrays(const LineStore* store,
+                             void* arrays[SCENEFILE_NUM_ARRAYS]) {
+  arrays[SCENEFILE_P1] = store->p1;
+  arrays[SCENEFILE_P2] = store->p2;
+  arrays[SCENEFILE_VELOCITY] = store->velocity;
+  arrays[SCENEFILE_RELATIVE_VECTOR] = store->relative_vector;
+  arrays[SCENEFILE_TOP_LEFT] = store->top_left;
+  arrays[SCENEFILE_BOTTOM_RIGHT] = store->bottom_right;
+  arrays[SCENEFILE_COLOR] = store->color;
+}
+
+static uint64_t SceneFile_align(uint64_t offset) {
+  uint64_t mask = SCENEFILE_ALIGNMENT - 1;
+  return (offset + mask) & ~mask;
+}
+
+void SceneFile_makeLine(Line* line, unsigned int id, window_dimension px1,
+                        window_dimension py1, window_dimension px2,
+                        window_dimension py2, window_dimension vx,
+                        window_dimension vy, int isGray) {
+  // convert window coordinates to box coordinates
+  windowToBox(&line->p1.x, &line->p1.y, px1, py1);
+  windowToBox(&line->p2.x, &line->p2.y, px2, py2);
+
+  // convert window velocity to box velocity
+  velocityWindowToBox(&line->velocity.x, &line->velocity.y, vx, vy);
+
+  // store color
+  line->color = (Color) isGray;
+
+  // store line ID
+  line->id = id;
+
+  // precompute some information about the line
+  line->relative_vector = Vec_makeFromLine(*line);
+  line->top_left = (Vec) {.x = MIN(line->p1.x, line->p2.x), .y = MIN(line->p1.y, line->p2.y)};
+  line->bottom_right = (Vec) {.x = MAX(line->p1.x, line->p2.x), .y = MAX(line->p1.y, line->p2.y)};
+}
+
+// ********************************* Text ***********************************
+
+// Powers of ten that are exact as doubles
+static const double SceneFile_pow10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13,
+  1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Longest number handed to strtod
+#define SCENEFILE_MAX_NUMBER 64
+
+static inline const char* SceneFile_skipSpace(const char* p, const char* end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+    p++;
+  }
+  return p;
+}
+
+// Skips whitespace, then the character c.  Returns NULL if c is not next.
+static inline const char* SceneFile_expect(const char* p, const char* end,
+                                           char c) {
+  p = SceneFile_skipSpace(p, end);
+  return p < end && *p == c ? p + 1 : NULL;
+}
+
+// Parses an unsigned decimal integer after any whitespace.  Returns the
+// first character after it, or NULL if there is none.
+static const char* SceneFile_parseUnsigned(const char* p, const char* end,
+                                           unsigned int* value) {
+  p = SceneFile_skipSpace(p, end);
+  const char* digits = p;
+  unsigned long v = 0;
+  while (p < end && *p >= '0' && *p <= '9' && v <= UINT_MAX) {
+    v = v * 10 + (*p - '0');
+    p++;
+  }
+  if (p == digits || v > UINT_MAX) {
+    return NULL;
+  }
+  *value = v;
+  return p;
+}
+
+// Parses a double after any whitespace, rounding exactly as strtod does.
+// Returns the first character after it, or NULL if there is none.
+//
+// Numbers of the form [-]digits[.digits] with at most 15 significant digits
+// take the fast path: the digits and the power of ten are both exact
+// doubles, so one correctly rounded division gives the correctly rounded
+// result.  Anything else (exponents, long mantissas, inf, nan) is copied out
+// and passed to strtod.
+static const char* SceneFile_parseDouble(const char* p, const char* end,
+                                         double* value) {
+  p = SceneFile_skipSpace(p, end);
+  const char* start = p;
+  bool negative = p < end && *p == '-';
+  if (p < end && (*p == '-' || *p == '+')) {
+    p++;
+  }
+  uint64_t mantissa = 0;
+  int numRead = 0;
+  int numSignificant = 0;
+  int numFraction = 0;
+  while (p < end && *p >= '0' && *p <= '9') {
+    mantissa = mantissa * 10 + (*p++ - '0');
+    numSignificant += mantissa != 0;
+    numRead++;
+  }
+  if (p < end && *p == '.') {
+    p++;
+    while (p < end && *p >= '0' && *p <= '9') {
+      mantissa = mantissa * 10 + (*p++ - '0');
+      numSignificant += mantissa != 0;
+      numRead++;
+      numFraction++;
+    }
+  }
+  bool simple = numRead > 0 && numSignificant <= 15 && numFraction <= 22
+      && !(p < end && (*p == 'e' || *p == 'E' || *p == 'x' || *p == 'X'));
+  if (simple) {
+    double v = (double) mantissa / SceneFile_pow10[numFraction];
+    *value = negative ? -v : v;
+    return p;
+  }
+
+  char buffer[SCENEFILE_MAX_NUMBER + 1];
+  size_t length = MIN((size_t) (end - start), (size_t) SCENEFILE_MAX_NUMBER);
+  memcpy(buffer, start, length);
+  buffer[length] = '\0';
+  char* parsed;
+  *value = strtod(buffer, &parsed);
+  return parsed == buffer ? NULL : start + (parsed - buffer);
+}
+
+// Parses one line of a text scene, "(x1, y1), (x2, y2), vx, vy, isGray", as
+// the line with the given ID.  Returns false if it is malformed.
+static bool SceneFile_parseLine(const char* p, const char* end,
+                                unsigned int id, Line* line) {
+  window_dimension px1;
+  window_dimension py1;
+  window_dimension px2;
+  window_dimension py2;
+  window_dimension vx;
+  window_dimension vy;
+  unsigned int isGray;
+
+  if ((p = SceneFile_expect(p, end, '(')) == NULL
+      || (p = SceneFile_parseDouble(p, end, &px1)) == NULL
+      || (p = SceneFile_expect(p, end, ',')) == NULL
+      || (p = SceneFile_parseDouble(p, end, &py1)) == NULL
+      || (p = SceneFile_expect(p, end, ')')) == NULL
+      || (p = SceneFile_expect(p, end, ',')) == NULL
+      || (p = SceneFile_expect(p, end, '(')) == NULL
+      || (p = SceneFile_parseDouble(p, end, &px2)) == NULL
+      || (p = SceneFile_expect(p, end, ',')) == NULL
+      || (p = SceneFile_parseDouble(p, end, &py2)) == NULL
+      || (p = SceneFile_expect(p, end, ')')) == NULL
+      || (p = SceneFile_expect(p, end, ',')) == NULL
+      || (p = SceneFile_parseDouble(p, end, &vx)) == NULL
+      || (p = SceneFile_expect(p, end, ',')) == NULL
+      || (p = SceneFile_parseDouble(p, end, &vy)) == NULL
+      || (p = SceneFile_expect(p, end, ',')) == NULL
+      || (p = SceneFile_parseUnsigned(p, end, &isGray)) == NULL
+      || SceneFile_skipSpace(p, end) != end) {
+    return false;
+  }
+
+  SceneFile_makeLine(line, id, px1, py1, px2, py2, vx, vy, isGray);
+  return true;
+}
+
+// Returns true if [p, end) holds anything but whitespace.
+static inline bool SceneFile_isBlank(const char* p, const char* end) {
+  return SceneFile_skipSpace(p, end) == end;
+}
+
+typedef struct {
+  const char* begin;  // first character after the line count
+  const char* end;    // end of the file
+  unsigned int numChunks;
+
+  LineStore* store;
+  unsigned int* chunkFirstId;  // ID of each chunk's first line
+  unsigned int* chunkError;    // ID of each chunk's first malformed line,
+                               // or UINT_MAX
+} TextContext;
+
+// Returns the start of the given chunk: the start of the first row at or
+// after chunk * SCENEFILE_PARSE_CHUNK bytes into the text.
+static const char* SceneFile_chunkStart(const TextContext* text,
+                                        unsigned int chunk) {
+  if (chunk == 0) {
+    return text->begin;
+  }
+  if (chunk >= text->numChunks) {
+    return text->end;
+  }
+  const char* p = text->begin + (size_t) chunk * SCENEFILE_PARSE_CHUNK - 1;
+  const char* newline = memchr(p, '\n', text->end - p);
+  return newline == NULL ? text->end : newline + 1;
+}
+
+// Counts the lines in chunks [begin, end), storing each chunk's count in
+// chunkFirstId.
+static void SceneFile_countChunks(void* context, unsigned int begin,
+                                  unsigned int end) {
+  TextContext* text = context;
+  for (unsigned int c = begin; c < end; c++) {
+    const char* row = SceneFile_chunkStart(text, c);
+    const char* chunkEnd = SceneFile_chunkStart(text, c + 1);
+    unsigned int count = 0;
+    while (row < chunkEnd) {
+      const char* newline = memchr(row, '\n', chunkEnd - row);
+      const char* rowEnd = newline == NULL ? chunkEnd : newline;
+      count += !SceneFile_isBlank(row, rowEnd);
+      row = rowEnd + 1;
+    }
+    text->chunkFirstId[c] = count;
+  }
+}
+
+// Parses the lines in chunks [begin, end) into the store, numbering them from
+// each chunk's first ID.  Lines past the store's capacity are dropped.
+static void SceneFile_parseChunks(void* context, unsigned int begin,
+                                  unsigned int end) {
+  TextContext* text = context;
+  LineStore* store = text->store;
+  for (unsigned int c = begin; c < end; c++) {
+    const char* row = SceneFile_chunkStart(text, c);
+    const char* chunkEnd = SceneFile_chunkStart(text, c + 1);
+    unsigned int id = text->chunkFirstId[c];
+    text->chunkError[c] = UINT_MAX;
+    while (row < chunkEnd && id < store->capacity) {
+      const char* newline = memchr(row, '\n', chunkEnd - row);
+      const char* rowEnd = newline == NULL ? chunkEnd : newline;
+      if (!SceneFile_isBlank(row, rowEnd)) {
+        Line line;
+        if (!SceneFile_parseLine(row, rowEnd, id, &line)) {
+          text->chunkError[c] = id;
+          break;
+        }
+        store->p1[id] = line.p1;
+        store->p2[id] = line.p2;
+        store->velocity[id] = line.velocity;
+        store->relative_vector[id] = line.relative_vector;
+        store->top_left[id] = line.top_left;
+        store->bottom_right[id] = line.bottom_right;
+        store->color[id] = line.color;
+        id++;
+      }
+      row = rowEnd + 1;
+    }
+  }
+}
+
+// Parses a text scene, with the chunks of SCENEFILE_PARSE_CHUNK bytes
+// parsed in parallel.  Lines get the IDs they would get if the file were
+// read in order: each chunk counts its lines, and a prefix sum of the counts
+// gives every chunk the ID of its first line.  As when the file was read
+// with fscanf, the count in the header is a cap: rows past it are ignored,
+// and a file with fewer rows loads the rows it has.
+static bool SceneFile_parseText(const char* path, const char* data,
+                                size_t size, LineStore* store) {
+  const char* end = data + size;
+  unsigned int numOfLines;
+  const char* begin = SceneFile_parseUnsigned(data, end, &numOfLines);
+  if (begin == NULL) {
+    fprintf(stderr, "%s: missing line count\n", path);
+    return false;
+  }
+
+  TextContext text;
+  text.begin = begin;
+  text.end = end;
+  text.numChunks = (end - begin + SCENEFILE_PARSE_CHUNK - 1)
+      / SCENEFILE_PARSE_CHUNK;
+  text.store = store;
+  text.chunkFirstId = malloc(sizeof(unsigned int) * (text.numChunks + 1));
+  text.chunkError = malloc(sizeof(unsigned int) * (text.numChunks + 1));
+  assert(text.chunkFirstId != NULL && text.chunkError != NULL);
+
+  Parallel_for(text.numChunks, 1, SceneFile_countChunks, &text);
+  unsigned long total = 0;
+  for (unsigned int c = 0; c < text.numChunks; c++) {
+    unsigned int count = text.chunkFirstId[c];
+    text.chunkFirstId[c] = MIN(total, (unsigned long) numOfLines);
+    total += count;
+  }
+
+  *store = LineStore_make(numOfLines);
+  Parallel_for(text.numChunks, 1, SceneFile_parseChunks, &text);
+  store->numOfLines = MIN(total, (unsigned long) numOfLines);
+
+  unsigned int error = UINT_MAX;
+  for (unsigned int c = 0; c < text.numChunks; c++) {
+    error = MIN(error, text.chunkError[c]);
+  }
+  free(text.chunkFirstId);
+  free(text.chunkError);
+  if (error != UINT_MAX) {
+    fprintf(stderr, "%s: malformed line %u\n", path, error);
+    LineStore_destroy(store);
+    return false;
+  }
+  return true;
+}
+
+// ******************************** Binary **********************************
+
+// Checks the binary scene mapped at mapping, and makes store use its arrays.
+static bool SceneFile_useBinary(const char* path, void* mapping, size_t size,
+                                LineStore* store) {
+  if (size < sizeof(SceneFileHeader)) {
+    fprintf(stderr, "%s: truncated scene header\n", path);
+    return false;
+  }
+
+  const SceneFileHeader* header = mapping;
+  const char* error = NULL;
+  if (header->byteOrder != SCENEFILE_BYTE_ORDER) {
+    error = "written with the other byte order";
+  } else if (header->version != SCENEFILE_VERSION) {
+    error = "unsupported scene version";
+  }
+  void* arrays[SCENEFILE_NUM_ARRAYS];
+  for (int a = 0; a < SCENEFILE_NUM_ARRAYS && error == NULL; a++) {
+    uint64_t offset = header->offsets[a];
+    uint64_t length = (uint64_t) header->numOfLines * SceneFile_elementSize[a];
+    if (offset % SCENEFILE_ALIGNMENT != 0 || offset < sizeof(SceneFileHeader)
+        || offset > size || length > size - offset) {
+      error = "array out of bounds";
+    }
+    arrays[a] = (char*) mapping + offset;
+  }
+  if (error != NULL) {
+    fprintf(stderr, "%s: %s\n", path, error);
+    return false;
+  }
+
+  store->p1 = arrays[SCENEFILE_P1];
+  store->p2 = arrays[SCENEFILE_P2];
+  store->velocity = arrays[SCENEFILE_VELOCITY];
+  store->relative_vector = arrays[SCENEFILE_RELATIVE_VECTOR];
+  store->top_left = arrays[SCENEFILE_TOP_LEFT];
+  store->bottom_right = arrays[SCENEFILE_BOTTOM_RIGHT];
+  store->color = arrays[SCENEFILE_COLOR];
+  store->numOfLines = header->numOfLines;
+  store->capacity = header->numOfLines;
+  return true;
+}
+
+bool SceneFile_writeBinary(const char* path, const LineStore* store) {
+  FILE* fout = fopen(path, "wb");
+  if (fout == NULL) {
+    perror(path);
+    return false;
+  }
+
+  SceneFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SCENEFILE_MAGIC, sizeof(SCENEFILE_MAGIC));
+  header.version = SCENEFILE_VERSION;
+  header.byteOrder = SCENEFILE_BYTE_ORDER;
+  header.numOfLines = store->numOfLines;
+  uint64_t offset = sizeof(header);
+  for (int a = 0; a < SCENEFILE_NUM_ARRAYS; a++) {
+    offset = SceneFile_align(offset);
+    header.offsets[a] = offset;
+    offset += (uint64_t) store->numOfLines * SceneFile_elementSize[a];
+  }
+
+  void* arrays[SCENEFILE_NUM_ARRAYS];
+  SceneFile_arrays(store, arrays);
+  static const char padding[SCENEFILE_ALIGNMENT];
+  bool ok = fwrite(&header, sizeof(header), 1, fout) == 1;
+  offset = sizeof(header);
+  for (int a = 0; a < SCENEFILE_NUM_ARRAYS && ok; a++) {
+    size_t gap = header.offsets[a] - offset;
+    size_t length = (size_t) store->numOfLines * SceneFile_elementSize[a];
+    ok = fwrite(padding, 1, gap, fout) == gap
+        && fwrite(arrays[a], 1, length, fout) == length;
+    offset = header.offsets[a] + length;
+  }
+  if (fclose(fout) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    perror(path);
+  }
+  return ok;
+}
+
+// ******************************** Loading *********************************
+
+bool SceneFile_load(const char* path, LineStore* store) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    perror(path);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    perror(path);
+    close(fd);
+    return false;
+  }
+  size_t size = st.st_size;
+  if (size == 0) {
+    fprintf(stderr, "%s: empty scene\n", path);
+    close(fd);
+    return false;
+  }
+
+  // The mapping is private, so a binary scene's lines can be moved in place
+  // without writing to the file.
+  void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    perror(path);
+    return false;
+  }
+
+  bool binary = size >= sizeof(SCENEFILE_MAGIC)
+      && memcmp(mapping, SCENEFILE_MAGIC, sizeof(SCENEFILE_MAGIC)) == 0;
+  bool loaded;
+  if (binary) {
+    loaded = SceneFile_useBinary(path, mapping, size, store);
+    if (loaded) {
+      store->mapping = mapping;
+      store->mappingSize = size;
+      return true;
+    }
+  } else {
+    loaded = SceneFile_parseText(path, mapping, size, store);
+  }
+  munmap(mapping, size);
+  return loaded;
+}
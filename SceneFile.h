@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Scene files: the lines a simulation starts from.  Two formats are read,
+// and told apart by the first bytes of the file:
+//
+//  * Text (.in): the number of lines, then one line per row written as
+//    "(x1, y1), (x2, y2), vx, vy, isGray" in window coordinates.  The file
+//    is mapped into memory and parsed in parallel.
+//  * Binary: a SceneFileHeader followed by the arrays of a LineStore, in box
+//    coordinates and with the derived fields already computed.  The file is
+//    mapped into memory and used as the line storage without being copied.
+#ifndef SCENEFILE_H_
+#define SCENEFILE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "./Line.h"
+
+// First bytes of a binary scene file
+#define SCENEFILE_MAGIC "LINESCN"
+// Bumped whenever the binary layout changes; other versions are rejected
+#define SCENEFILE_VERSION 1
+// Written in the native byte order, so a file from a machine with the other
+// byte order is recognized and rejected
+#define SCENEFILE_BYTE_ORDER 0x01020304u
+// Alignment of every array in a binary scene file
+#define SCENEFILE_ALIGNMENT LINESTORE_ALIGNMENT
+// Bytes of a text scene each worker parses at a time
+#define SCENEFILE_PARSE_CHUNK (64 << 10)
+
+// The arrays of a binary scene file, in file order
+typedef enum {
+  SCENEFILE_P1,
+  SCENEFILE_P2,
+  SCENEFILE_VELOCITY,
+  SCENEFILE_RELATIVE_VECTOR,
+  SCENEFILE_TOP_LEFT,
+  SCENEFILE_BOTTOM_RIGHT,
+  SCENEFILE_COLOR,
+  SCENEFILE_NUM_ARRAYS
+} SceneFileArray;
+
+struct SceneFileHeader {
+  char magic[sizeof(SCENEFILE_MAGIC)];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint32_t numOfLines;
+  uint32_t reserved;
+  // Byte offset of each array from the start of the file
+  uint64_t offsets[SCENEFILE_NUM_ARRAYS];
+};
+typedef struct SceneFileHeader SceneFileHeader;
+
+// Fills in line, the line with the given ID, from its endpoints and velocity
+// in window coordinates, as they are written in a text scene.
+void SceneFile_makeLine(Line* line, unsigned int id, window_dimension px1,
+                        window_dimension py1, window_dimension px2,
+                        window_dimension py2, window_dimension vx,
+                        window_dimension vy, int isGray);
+
+// Loads the scene in the file at path, in either format, into a new store.
+// Returns false, after printing the reason to stderr, if the file cannot be
+// read or is malformed.  The store is released with LineStore_destroy.
+bool SceneFile_load(const char* path, LineStore* store);
+
+// Writes the lines in store to path in the binary format.  Returns false,
+// after printing the reason to stderr, if the file cannot be written.
+bool SceneFile_writeBinary(const char* path, const LineStore* store);
+
+#endif  // SCENEFILE_H_
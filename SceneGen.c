@@ -0,0 +1,314 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// SceneGen -- generates large synthetic scenes for scaling benchmarks.  The
+// scene depends only on the options, so a seed names a scene exactly.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "./Line.h"
+#include "./SceneFile.h"
+
+// Attempts at placing a line inside the window before it is clamped
+#define SCENEGEN_MAX_TRIES 100
+
+// A distribution of non-negative values, written "uniform:MIN:MAX",
+// "normal:MEAN:SD", "exponential:MEAN" or "constant:VALUE".
+typedef enum {
+  DIST_UNIFORM,
+  DIST_NORMAL,
+  DIST_EXPONENTIAL,
+  DIST_CONSTANT
+} DistType;
+
+typedef struct {
+  DistType type;
+  double a;
+  double b;
+} Dist;
+
+typedef struct {
+  uint64_t seed;
+  unsigned int numOfLines;
+  Dist length;           // line length, in pixels
+  Dist speed;            // speed, in pixels per time step
+  unsigned int numClusters;  // 0 places lines uniformly
+  double clusterSpread;  // standard deviation around a cluster, in pixels
+  double axisAligned;    // share of horizontal or vertical lines
+  double stationary;     // share of lines that do not move
+  double gray;           // share of gray lines
+  bool binary;
+} SceneGenParams;
+
+// ******************************** Random **********************************
+
+// SplitMix64, chosen so that a seed gives the same scene everywhere.
+static uint64_t SceneGen_next(uint64_t* state) {
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+// Returns a double uniform in [0, 1).
+static double SceneGen_uniform(uint64_t* state) {
+  return (SceneGen_next(state) >> 11) * 0x1.0p-53;
+}
+
+// Returns a standard normal deviate (Box-Muller).
+static double SceneGen_normal(uint64_t* state) {
+  double u = 1 - SceneGen_uniform(state);
+  double v = SceneGen_uniform(state);
+  return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+static double SceneGen_sample(const Dist* dist, uint64_t* state) {
+  double x;
+  switch (dist->type) {
+    case DIST_UNIFORM:
+      x = dist->a + (dist->b - dist->a) * SceneGen_uniform(state);
+      break;
+    case DIST_NORMAL:
+      x = dist->a + dist->b * SceneGen_normal(state);
+      break;
+    case DIST_EXPONENTIAL:
+      x = -dist->a * log(1 - SceneGen_uniform(state));
+      break;
+    default:
+      x = dist->a;
+      break;
+  }
+  return fabs(x);
+}
+
+static bool SceneGen_parseDist(const char* spec, Dist* dist) {
+  char name[16];
+  int n = sscanf(spec, "%15[a-z]:%lf:%lf", name, &dist->a, &dist->b);
+  if (n == 3 && strcmp(name, "uniform") == 0 && dist->a <= dist->b) {
+    dist->type = DIST_UNIFORM;
+  } else if (n == 3 && strcmp(name, "normal") == 0) {
+    dist->type = DIST_NORMAL;
+  } else if (n == 2 && strcmp(name, "exponential") == 0) {
+    dist->type = DIST_EXPONENTIAL;
+  } else if (n == 2 && strcmp(name, "constant") == 0) {
+    dist->type = DIST_CONSTANT;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// ******************************** Scenes **********************************
+
+// Rounds x as it is written to a text scene, so that both formats of a
+// scene hold the same values.
+static double SceneGen_round(double x) {
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%f", x);
+  return strtod(buffer, NULL);
+}
+
+static bool SceneGen_inWindow(double x, double y) {
+  return x >= 0 && x <= WINDOW_WIDTH && y >= 0 && y <= WINDOW_HEIGHT;
+}
+
+// Generates the scene described by params, and writes it to fout as text
+// or appends it to store.
+static void SceneGen_generate(const SceneGenParams* params, FILE* fout,
+                              LineStore* store) {
+  uint64_t state = params->seed;
+
+  double* centers = malloc(sizeof(double) * 2 * (params->numClusters + 1));
+  for (unsigned int c = 0; c < params->numClusters; c++) {
+    centers[2 * c] = WINDOW_WIDTH * SceneGen_uniform(&state);
+    centers[2 * c + 1] = WINDOW_HEIGHT * SceneGen_uniform(&state);
+  }
+
+  if (fout != NULL) {
+    fprintf(fout, "%u\n", params->numOfLines);
+  }
+  for (unsigned int id = 0; id < params->numOfLines; id++) {
+    double length = SceneGen_sample(&params->length, &state);
+    double angle = SceneGen_uniform(&state) < params->axisAligned
+        ? (SceneGen_next(&state) & 1) * M_PI / 2
+        : M_PI * SceneGen_uniform(&state);
+    double dx = length / 2 * cos(angle);
+    double dy = length / 2 * sin(angle);
+
+    // Place the midpoint, retrying until the whole line is in the window.
+    double x;
+    double y;
+    for (int tries = 0; ; tries++) {
+      if (params->numClusters > 0) {
+        unsigned int c = SceneGen_next(&state) % params->numClusters;
+        x = centers[2 * c] + params->clusterSpread * SceneGen_normal(&state);
+        y = centers[2 * c + 1]
+            + params->clusterSpread * SceneGen_normal(&state);
+      } else {
+        x = WINDOW_WIDTH * SceneGen_uniform(&state);
+        y = WINDOW_HEIGHT * SceneGen_uniform(&state);
+      }
+      bool inside = SceneGen_inWindow(x - dx, y - dy)
+          && SceneGen_inWindow(x + dx, y + dy);
+      if (inside || tries == SCENEGEN_MAX_TRIES) {
+        break;
+      }
+    }
+    double x1 = fmin(fmax(x - dx, 0), WINDOW_WIDTH);
+    double y1 = fmin(fmax(y - dy, 0), WINDOW_HEIGHT);
+    double x2 = fmin(fmax(x + dx, 0), WINDOW_WIDTH);
+    double y2 = fmin(fmax(y + dy, 0), WINDOW_HEIGHT);
+
+    double vx = 0;
+    double vy = 0;
+    if (SceneGen_uniform(&state) >= params->stationary) {
+      double speed = SceneGen_sample(&params->speed, &state);
+      double heading = 2 * M_PI * SceneGen_uniform(&state);
+      vx = speed * cos(heading);
+      vy = speed * sin(heading);
+    }
+    int isGray = SceneGen_uniform(&state) < params->gray;
+
+    if (fout != NULL) {
+      fprintf(fout, "(%f, %f), (%f, %f), %f, %f, %d\n", x1, y1, x2, y2, vx,
+              vy, isGray);
+    } else {
+      Line line;
+      SceneFile_makeLine(&line, id, SceneGen_round(x1), SceneGen_round(y1),
+                         SceneGen_round(x2), SceneGen_round(y2),
+                         SceneGen_round(vx), SceneGen_round(vy), isGray);
+      LineStore_addLine(store, &line);
+    }
+  }
+  free(centers);
+}
+
+static void SceneGen_usage(const char* name) {
+  printf("Usage: %s [-s seed] [-n lines] [-l dist] [-v dist] [-c clusters:spread] [-a share] [-z share] [-g share] [-b] <output scene>\n", name);
+  printf("  -s : random seed (default 1)\n");
+  printf("  -n : number of lines (default 10000)\n");
+  printf("  -l : line length in pixels (default uniform:5:30)\n");
+  printf("  -v : speed in pixels per time step (default uniform:0:100)\n");
+  printf("  -c : gather lines around this many random points, with this\n");
+  printf("       standard deviation in pixels (default 0, spread uniformly)\n");
+  printf("  -a : share of horizontal or vertical lines (default 0)\n");
+  printf("  -z : share of lines that do not move (default 0)\n");
+  printf("  -g : share of gray lines (default 0)\n");
+  printf("  -b : write the binary scene format instead of text\n");
+  printf("  A dist is uniform:MIN:MAX, normal:MEAN:SD, exponential:MEAN or\n");
+  printf("  constant:VALUE.  The scene depends only on the options.\n");
+  exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+  int optchar;
+  SceneGenParams params = {
+    .seed = 1,
+    .numOfLines = 10000,
+    .length = { .type = DIST_UNIFORM, .a = 5, .b = 30 },
+    .speed = { .type = DIST_UNIFORM, .a = 0, .b = 100 },
+    .numClusters = 0,
+    .clusterSpread = 0,
+    .axisAligned = 0,
+    .stationary = 0,
+    .gray = 0,
+    .binary = false
+  };
+  extern int optind;
+  extern char* optarg;
+
+  while ((optchar = getopt(argc, argv, "s:n:l:v:c:a:z:g:bh")) != -1) {
+    switch (optchar) {
+      case 's':
+        params.seed = strtoull(optarg, NULL, 0);
+        break;
+      case 'n':
+        if (atoi(optarg) <= 0) {
+          SceneGen_usage(argv[0]);
+        }
+        params.numOfLines = atoi(optarg);
+        break;
+      case 'l':
+        if (!SceneGen_parseDist(optarg, &params.length)) {
+          SceneGen_usage(argv[0]);
+        }
+        break;
+      case 'v':
+        if (!SceneGen_parseDist(optarg, &params.speed)) {
+          SceneGen_usage(argv[0]);
+        }
+        break;
+      case 'c':
+        if (sscanf(optarg, "%u:%lf", &params.numClusters,
+                   &params.clusterSpread) != 2) {
+          SceneGen_usage(argv[0]);
+        }
+        break;
+      case 'a':
+        params.axisAligned = atof(optarg);
+        break;
+      case 'z':
+        params.stationary = atof(optarg);
+        break;
+      case 'g':
+        params.gray = atof(optarg);
+        break;
+      case 'b':
+        params.binary = true;
+        break;
+      default:
+        SceneGen_usage(argv[0]);
+    }
+  }
+  if (argc - optind != 1) {
+    SceneGen_usage(argv[0]);
+  }
+  const char* path = argv[optind];
+
+  if (params.binary) {
+    LineStore lines = LineStore_make(params.numOfLines);
+    SceneGen_generate(&params, NULL, &lines);
+    bool written = SceneFile_writeBinary(path, &lines);
+    LineStore_destroy(&lines);
+    if (!written) {
+      exit(-1);
+    }
+  } else {
+    FILE* fout = fopen(path, "w");
+    if (fout == NULL) {
+      perror(path);
+      exit(-1);
+    }
+    SceneGen_generate(&params, fout, NULL);
+    if (fclose(fout) != 0) {
+      perror(path);
+      exit(-1);
+    }
+  }
+  printf("Wrote %u lines to %s\n", params.numOfLines, path);
+  return 0;
+}
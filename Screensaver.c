@@ -27,9 +27,15 @@
 #include "./fasttime.h"
 #include "./Line.h"
 #include "./LineDemo.h"
+#include "./CollisionStats.h"
+#include "./Parallel.h"
+#include "./PerfCounters.h"
+#include "./PhaseTimer.h"
+#include "./Trace.h"
+#include "./WorkSpan.h"
 
 // The PROFILE_BUILD preprocessor define is used to indicate we are building for
-// profiling, so don't include any graphics or Cilk functions.
+// profiling, so don't include any graphics functions.
 #ifndef PROFILE_BUILD
 #include "./GraphicStuff.h"
 #endif
@@ -46,6 +52,23 @@ void lineMain(LineDemo *lineDemo) {
   }
 }
 
+static void printUsage(const char* program) {
+  printf("Usage: %s [-g] [-i] [-b engine] [-d depth] [-n lines] [-w workers] <numFrames> <optional input_file>\n", program);
+  printf("  -g : show graphics\n");
+  printf("  -i : show first image only (ignore numFrames)\n");
+  printf("  -b : broad phase, %s, %s or %s (default %s)\n",
+         BroadPhase_typeName(BROADPHASE_QUADTREE),
+         BroadPhase_typeName(BROADPHASE_GRID),
+         BroadPhase_typeName(BROADPHASE_SAP),
+         BroadPhase_typeName(BROADPHASE_QUADTREE));
+  printf("  -d : maximum quadtree depth, 0 to %d (default %d)\n",
+         QUADTREE_MAX_DEPTH, QUADTREE_DEFAULT_MAX_DEPTH);
+  printf("  -n : lines a quadtree leaf holds before it may split (default %d)\n",
+         QUADTREE_DEFAULT_LEAF_CAPACITY);
+  printf("  -w : worker threads (default $%s, or one per processor)\n",
+         PARALLEL_WORKERS_ENV);
+}
+
 #ifndef TEST
 int main(int argc, char *argv[]) {
   int optchar;
@@ -54,10 +77,13 @@ int main(int argc, char *argv[]) {
 #endif
   bool imageOnlyFlag = false;
   unsigned int numFrames = 1;
+  QuadtreeParams quadtreeParams = QuadtreeParams_default();
+  BroadPhaseType broadPhaseType = BROADPHASE_QUADTREE;
   extern int optind;
+  extern char* optarg;
 
   // Process command line options.
-  while ((optchar = getopt(argc, argv, "gi")) != -1) {
+  while ((optchar = getopt(argc, argv, "gib:d:n:w:")) != -1) {
     switch (optchar) {
       case 'g':
 #ifndef PROFILE_BUILD
@@ -70,6 +96,37 @@ int main(int argc, char *argv[]) {
         graphicDemoFlag = true;
 #endif
         break;
+      case 'b':
+        if (!BroadPhase_parseType(optarg, &broadPhaseType)) {
+          printf("Ignoring unknown broad phase: %s\n", optarg);
+        }
+        break;
+      case 'd': {
+        char* end;
+        long depth = strtol(optarg, &end, 10);
+        if (end == optarg || *end != '\0' || depth < 0
+            || depth > QUADTREE_MAX_DEPTH) {
+          printf("Invalid quadtree depth: %s\n", optarg);
+          printUsage(argv[0]);
+          exit(-1);
+        }
+        quadtreeParams.maxDepth = depth;
+        break;
+      }
+      case 'n':
+        if (atoi(optarg) > 0) {
+          quadtreeParams.leafCapacity = atoi(optarg);
+        } else {
+          printf("Ignoring non-positive leaf capacity: %s\n", optarg);
+        }
+        break;
+      case 'w':
+        if (atoi(optarg) > 0) {
+          Parallel_setNumWorkers(atoi(optarg));
+        } else {
+          printf("Ignoring non-positive worker count: %s\n", optarg);
+        }
+        break;
       default:
         printf("Ignoring unrecognized option: %c\n", optchar);
         continue;
@@ -85,9 +142,7 @@ int main(int argc, char *argv[]) {
 
     // Check to make sure number of arguments is correct.
     if (remaining_args < 1) {
-      printf("Usage: %s [-g] [-i] <numFrames> <optional input_file>\n", argv[0]);
-      printf("  -g : show graphics\n");
-      printf("  -i : show first image only (ignore numFrames)\n");
+      printUsage(argv[0]);
       exit(-1);
     }
 
@@ -106,6 +161,8 @@ int main(int argc, char *argv[]) {
   LineDemo *lineDemo = LineDemo_new();
   LineDemo_setInputFile(input_file_path);
   LineDemo_initLine(lineDemo);
+  LineDemo_setQuadtreeParams(lineDemo, quadtreeParams);
+  LineDemo_setBroadPhase(lineDemo, broadPhaseType);
   LineDemo_setNumFrames(lineDemo, numFrames);
 
   const fasttime_t start_time = gettime();
@@ -131,7 +188,28 @@ int main(int argc, char *argv[]) {
          LineDemo_getNumLineWallCollisions(lineDemo));
   printf("%u Line-Line Collisions\n",
          LineDemo_getNumLineLineCollisions(lineDemo));
+#ifdef COLLISION_STATS
+  printf("%.0f Pairs Tested per Frame\n",
+         LineDemo_getPairsTestedPerFrame(lineDemo));
+  printf("%lu Mallocs after First Frame\n",
+         LineDemo_getMallocsAfterFirstFrame(lineDemo));
+#endif
   printf("---- END RESULTS ----\n");
+#ifdef PHASE_TIMERS
+  PhaseTimer_print();
+#endif
+#ifdef PERF_COUNTERS
+  PerfCounters_print();
+#endif
+#ifdef WORK_SPAN
+  WorkSpan_print();
+#endif
+#ifdef COLLISION_STATS
+  CollisionStats_print();
+#endif
+#ifdef TIMELINE_TRACE
+  Trace_write();
+#endif
 
   // delete objects
   LineDemo_delete(lineDemo);
@@ -0,0 +1,205 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "./SweepAndPrune.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "./IntersectionBatch.h"
+#include "./IntersectionDetection.h"
+#include "./IntersectionEventList.h"
+#include "./Parallel.h"
+
+// Stores line l's current swept box at position i.
+static inline void load_box(SweepAndPrune* sap, const LineStore* store,
+                            unsigned int i, unsigned int l) {
+  Vec tl = store->top_left[l];
+  Vec br = store->bottom_right[l];
+  Vec v = store->velocity[l];
+  double xlo = MIN(tl.x, tl.x + v.x);
+  double xhi = MAX(br.x, br.x + v.x);
+  double ylo = MIN(tl.y, tl.y + v.y);
+  double yhi = MAX(br.y, br.y + v.y);
+
+  // A line whose coordinates have become NaN overlaps nothing, but NaN keys
+  // would break the sort.  Give it an empty box that sorts last instead.
+  if (!(xlo <= xhi && ylo <= yhi)) {
+    xlo = ylo = INFINITY;
+    xhi = yhi = -INFINITY;
+  }
+  sap->xlo[i] = xlo;
+  sap->xhi[i] = xhi;
+  sap->ylo[i] = ylo;
+  sap->yhi[i] = yhi;
+}
+
+typedef struct {
+  double key;
+  unsigned int id;
+} SortEntry;
+
+static int compare_entries(const void* a, const void* b) {
+  const SortEntry* x = a;
+  const SortEntry* y = b;
+  if (x->key != y->key) {
+    return (x->key > y->key) - (x->key < y->key);
+  }
+  return (x->id > y->id) - (x->id < y->id);
+}
+
+SweepAndPrune SweepAndPrune_make(const LineStore* store) {
+  SweepAndPrune sap;
+  unsigned int n = store->numOfLines;
+  unsigned int size = MAX(1, n);
+  sap.numOfLines = n;
+  sap.order = malloc(sizeof(unsigned int) * size);
+  sap.xlo = malloc(sizeof(double) * size);
+  sap.xhi = malloc(sizeof(double) * size);
+  sap.ylo = malloc(sizeof(double) * size);
+  sap.yhi = malloc(sizeof(double) * size);
+  assert(sap.order != NULL && sap.xlo != NULL && sap.xhi != NULL
+         && sap.ylo != NULL && sap.yhi != NULL);
+
+  // Sort once from scratch; later frames only repair the order.
+  SortEntry* entries = malloc(sizeof(SortEntry) * size);
+  assert(entries != NULL);
+  sap.numMallocs = 6;  // the five arrays and entries
+  for (unsigned int l = 0; l < n; l++) {
+    load_box(&sap, store, l, l);
+    entries[l] = (SortEntry) { .key = sap.xlo[l], .id = l };
+  }
+  qsort(entries, n, sizeof(SortEntry), compare_entries);
+  for (unsigned int i = 0; i < n; i++) {
+    sap.order[i] = entries[i].id;
+    load_box(&sap, store, i, sap.order[i]);
+  }
+  free(entries);
+  return sap;
+}
+
+void SweepAndPrune_destroy(SweepAndPrune* sap) {
+  free(sap->order);
+  free(sap->xlo);
+  free(sap->xhi);
+  free(sap->ylo);
+  free(sap->yhi);
+  sap->order = NULL;
+}
+
+void SweepAndPrune_update(SweepAndPrune* sap, const LineStore* store) {
+  assert(store->numOfLines == sap->numOfLines);
+  for (unsigned int i = 0; i < sap->numOfLines; i++) {
+    load_box(sap, store, i, sap->order[i]);
+  }
+
+  // Insertion sort by xlo, carrying each line's box along with it.
+  for (unsigned int i = 1; i < sap->numOfLines; i++) {
+    double xlo = sap->xlo[i];
+    if (!(xlo < sap->xlo[i - 1])) {
+      continue;
+    }
+    unsigned int l = sap->order[i];
+    double xhi = sap->xhi[i];
+    double ylo = sap->ylo[i];
+    double yhi = sap->yhi[i];
+    unsigned int j = i;
+    while (j > 0 && xlo < sap->xlo[j - 1]) {
+      sap->order[j] = sap->order[j - 1];
+      sap->xlo[j] = sap->xlo[j - 1];
+      sap->xhi[j] = sap->xhi[j - 1];
+      sap->ylo[j] = sap->ylo[j - 1];
+      sap->yhi[j] = sap->yhi[j - 1];
+      j--;
+    }
+    sap->order[j] = l;
+    sap->xlo[j] = xlo;
+    sap->xhi[j] = xhi;
+    sap->ylo[j] = ylo;
+    sap->yhi[j] = yhi;
+  }
+}
+
+// Tests l against candidates and appends the hits to list.
+static inline void test_candidates(IntersectionEventList* list,
+                                   const LineStore* store, unsigned int l,
+                                   const unsigned int* candidates,
+                                   unsigned int count) {
+  IntersectionType types[INTERSECT_BATCH_SIZE];
+  unsigned int hits = intersectBatch(store, l, candidates, count, types);
+  if (hits) {
+    IntersectionEventList_appendHits(list, l, candidates, hits, types);
+  }
+}
+
+typedef struct {
+  const SweepAndPrune* sap;
+  IntersectionEventList* events;
+  const LineStore* store;
+} DetectContext;
+
+// Tests the lines at sorted positions from begin up to end against the
+// later lines their boxes overlap.  Returns the number of pairs tested.
+static unsigned long detect_from(void* context, unsigned int begin,
+                                 unsigned int end) {
+  DetectContext* c = context;
+  const SweepAndPrune* sap = c->sap;
+  unsigned long tested = 0;
+
+  for (unsigned int i = begin; i < end; i++) {
+    unsigned int l1 = sap->order[i];
+    double xhi = sap->xhi[i];
+    double ylo = sap->ylo[i];
+    double yhi = sap->yhi[i];
+    unsigned int candidates[INTERSECT_BATCH_SIZE];
+    unsigned int count = 0;
+
+    // Every later line starts at or after this one, so their x intervals
+    // overlap exactly while they start before this one ends.
+    for (unsigned int j = i + 1; j < sap->numOfLines && sap->xlo[j] <= xhi;
+         j++) {
+      if (sap->ylo[j] > yhi || ylo > sap->yhi[j]) {
+        continue;
+      }
+      candidates[count++] = sap->order[j];
+      if (count == INTERSECT_BATCH_SIZE) {
+        test_candidates(c->events, c->store, l1, candidates, count);
+        tested += count;
+        count = 0;
+      }
+    }
+    if (count > 0) {
+      test_candidates(c->events, c->store, l1, candidates, count);
+      tested += count;
+    }
+  }
+  return tested;
+}
+
+unsigned long SweepAndPrune_detectCollisions(
+    const SweepAndPrune* sap, IntersectionEventList* events,
+    const LineStore* store) {
+  DetectContext context = { .sap = sap, .events = events, .store = store };
+  return Parallel_sum(sap->numOfLines, SWEEPANDPRUNE_LINE_GRAIN, detect_from,
+                      &context);
+}
@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Sweep-and-prune broad phase: lines are kept sorted by the left edge of
+// their swept bounding boxes, and a line is only tested against the lines
+// whose boxes start before its own box ends.
+#ifndef SWEEPANDPRUNE_H_
+#define SWEEPANDPRUNE_H_
+
+#include "./Line.h"
+#include "./IntersectionEventList.h"
+
+// Lines each worker takes at a time when testing pairs
+#define SWEEPANDPRUNE_LINE_GRAIN 64
+
+struct SweepAndPrune {
+  // line IDs, sorted by the left edge of their swept boxes
+  unsigned int* order;
+
+  // swept box of each line this frame, indexed by position in order
+  double* xlo;
+  double* xhi;
+  double* ylo;
+  double* yhi;
+
+  unsigned int numOfLines;
+
+  // calls to malloc made by the structure since it was made
+  unsigned long numMallocs;
+};
+typedef struct SweepAndPrune SweepAndPrune;
+
+// Makes a sweep-and-prune structure holding every line in store, sorted.
+SweepAndPrune SweepAndPrune_make(const LineStore* store);
+
+void SweepAndPrune_destroy(SweepAndPrune* sap);
+
+// Recomputes every line's swept box and restores the sort with an insertion
+// sort.  Lines move little between frames, so this is close to linear.
+void SweepAndPrune_update(SweepAndPrune* sap, const LineStore* store);
+
+// Appends an event to events for every intersecting pair of lines whose
+// swept boxes overlap.  Returns the number of pairs tested.
+unsigned long SweepAndPrune_detectCollisions(
+    const SweepAndPrune* sap, IntersectionEventList* events,
+    const LineStore* store);
+
+#endif  // SWEEPANDPRUNE_H_
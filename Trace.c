@@ -0,0 +1,189 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "./Trace.h"
+
+#ifdef TIMELINE_TRACE
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "./Parallel.h"
+
+typedef enum {
+  TRACE_EVENT_RANGE,  // a: first iteration, b: end of the range
+  TRACE_EVENT_PHASE,  // name: the phase's name
+  TRACE_EVENT_FRAME   // a: the frame's number; start == end
+} TraceEventKind;
+
+// Times are in seconds since Trace_init().
+typedef struct {
+  double start;
+  double end;
+  const char* name;
+  TraceEventKind kind;
+  unsigned int a;
+  unsigned int b;
+} TraceEvent;
+
+// One worker's events; event i is at events[i % TRACE_RING_SIZE].  Only
+// the worker writes to it, and it is read once every loop has finished.
+typedef struct {
+  TraceEvent* events;
+  unsigned long count;
+} __attribute__((aligned(64))) TraceRing;
+
+static TraceRing* Trace_rings = NULL;
+static unsigned int Trace_numRings = 0;
+static fasttime_t Trace_epoch;
+static unsigned int Trace_numFrames = 0;
+
+void Trace_init() {
+  if (Trace_rings != NULL) {
+    return;
+  }
+  Trace_numRings = Parallel_getNumWorkers();
+  int error = posix_memalign((void**) &Trace_rings, 64,
+                             sizeof(TraceRing) * Trace_numRings);
+  assert(error == 0);
+  (void) error;
+  for (unsigned int w = 0; w < Trace_numRings; w++) {
+    Trace_rings[w].events = malloc(sizeof(TraceEvent) * TRACE_RING_SIZE);
+    assert(Trace_rings[w].events != NULL);
+    Trace_rings[w].count = 0;
+  }
+  Trace_epoch = gettime();
+}
+
+static void Trace_record(fasttime_t start, TraceEventKind kind,
+                         const char* name, unsigned int a, unsigned int b) {
+  if (Trace_rings == NULL) {
+    return;
+  }
+  unsigned int worker = Parallel_getWorkerId();
+  assert(worker < Trace_numRings);
+  TraceRing* ring = &Trace_rings[worker];
+  TraceEvent* event = &ring->events[ring->count % TRACE_RING_SIZE];
+  event->start = tdiff(Trace_epoch, start);
+  event->end = tdiff(Trace_epoch, gettime());
+  event->name = name;
+  event->kind = kind;
+  event->a = a;
+  event->b = b;
+  ring->count++;
+}
+
+void Trace_range(fasttime_t start, unsigned int begin, unsigned int end) {
+  Trace_record(start, TRACE_EVENT_RANGE, NULL, begin, end);
+}
+
+void Trace_phase(const char* name, fasttime_t start) {
+  Trace_record(start, TRACE_EVENT_PHASE, name, 0, 0);
+}
+
+void Trace_endFrame() {
+  Trace_record(gettime(), TRACE_EVENT_FRAME, NULL, Trace_numFrames, 0);
+  Trace_numFrames++;
+}
+
+// Returns the earliest time from which every worker still holds all of its
+// events, so that no worker's track starts with a false gap.
+static double Trace_windowStart() {
+  double windowStart = 0;
+  for (unsigned int w = 0; w < Trace_numRings; w++) {
+    const TraceRing* ring = &Trace_rings[w];
+    if (ring->count > TRACE_RING_SIZE) {
+      double oldest = ring->events[ring->count % TRACE_RING_SIZE].start;
+      if (oldest > windowStart) {
+        windowStart = oldest;
+      }
+    }
+  }
+  return windowStart;
+}
+
+static void Trace_writeEvent(FILE* file, unsigned int worker,
+                             const TraceEvent* event) {
+  // Chrome wants microseconds.
+  double ts = 1e6 * event->start;
+  double dur = 1e6 * (event->end - event->start);
+  switch (event->kind) {
+    case TRACE_EVENT_RANGE:
+      fprintf(file, ",\n{\"name\":\"range\",\"cat\":\"loop\",\"ph\":\"X\","
+              "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,"
+              "\"args\":{\"begin\":%u,\"end\":%u}}",
+              ts, dur, worker, event->a, event->b);
+      break;
+    case TRACE_EVENT_PHASE:
+      fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"phase\",\"ph\":\"X\","
+              "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+              event->name, ts, dur, worker);
+      break;
+    case TRACE_EVENT_FRAME:
+      fprintf(file, ",\n{\"name\":\"frame\",\"cat\":\"frame\",\"ph\":\"i\","
+              "\"s\":\"g\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,"
+              "\"args\":{\"frame\":%u}}",
+              ts, worker, event->a);
+      break;
+  }
+}
+
+void Trace_write() {
+  if (Trace_rings == NULL) {
+    return;
+  }
+  const char* path = getenv(TRACE_FILE_ENV);
+  if (path == NULL || path[0] == '\0') {
+    path = "trace.json";
+  }
+  FILE* file = fopen(path, "w");
+  if (file == NULL) {
+    perror(path);
+    return;
+  }
+
+  fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+          "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+          "\"args\":{\"name\":\"Screensaver\"}}");
+  double windowStart = Trace_windowStart();
+  unsigned long written = 0;
+  for (unsigned int w = 0; w < Trace_numRings; w++) {
+    fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+            "\"tid\":%u,\"args\":{\"name\":\"worker %u\"}}", w, w);
+    const TraceRing* ring = &Trace_rings[w];
+    unsigned long first = ring->count > TRACE_RING_SIZE
+        ? ring->count - TRACE_RING_SIZE : 0;
+    for (unsigned long i = first; i < ring->count; i++) {
+      const TraceEvent* event = &ring->events[i % TRACE_RING_SIZE];
+      if (event->start >= windowStart) {
+        Trace_writeEvent(file, w, event);
+        written++;
+      }
+    }
+  }
+  fprintf(file, "\n]}\n");
+  fclose(file);
+  printf("Wrote %lu trace events to %s\n", written, path);
+}
+
+#endif  // TIMELINE_TRACE
@@ -0,0 +1,73 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Timeline tracing.  Built with -DTIMELINE_TRACE ("make TRACE=1", which also
+// turns on the phase timers), every phase of a frame and every range of
+// iterations a worker runs in a parallel loop are recorded, and Screensaver
+// writes them at exit as a Chrome trace_event JSON file, for chrome://tracing
+// or Perfetto.  Each worker records into its own ring buffer, so recording
+// takes no locks; a worker whose buffer fills keeps its newest events.
+// Otherwise the tracing macros expand to nothing.
+#ifndef TRACE_H_
+#define TRACE_H_
+
+// Environment variable naming the trace file, "trace.json" by default
+#define TRACE_FILE_ENV "SCREENSAVER_TRACE"
+
+// Events each worker's ring buffer holds
+#define TRACE_RING_SIZE (1 << 16)
+
+#ifdef TIMELINE_TRACE
+
+#include "./fasttime.h"
+
+// Makes the ring buffers.  Events recorded before are dropped.
+#define TRACE_INIT() Trace_init()
+// Starts a timer named timer.
+#define TRACE_START(timer) fasttime_t timer = gettime()
+// Records that the calling worker ran iterations [begin, end) of a loop
+// since timer started.
+#define TRACE_RANGE(timer, begin, end) Trace_range((timer), (begin), (end))
+
+void Trace_init();
+
+void Trace_range(fasttime_t start, unsigned int begin, unsigned int end);
+
+// Records that the phase named name ran from start until now.  Called by
+// PhaseTimer_stop().
+void Trace_phase(const char* name, fasttime_t start);
+
+// Records the end of a frame.  Called by PhaseTimer_endFrame().
+void Trace_endFrame();
+
+// Writes the recorded events to the file named by TRACE_FILE_ENV.
+void Trace_write();
+
+#else
+
+#define TRACE_INIT()
+#define TRACE_START(timer)
+#define TRACE_RANGE(timer, begin, end)
+
+#endif  // TIMELINE_TRACE
+
+#endif  // TRACE_H_
@@ -0,0 +1,235 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "./UniformGrid.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./IntersectionBatch.h"
+#include "./IntersectionDetection.h"
+#include "./IntersectionEventList.h"
+#include "./Parallel.h"
+
+static int compare_doubles(const void* a, const void* b) {
+  double x = *(const double*) a;
+  double y = *(const double*) b;
+  return (x > y) - (x < y);
+}
+
+UniformGrid UniformGrid_make(const LineStore* store) {
+  UniformGrid grid;
+  unsigned int n = store->numOfLines;
+  double boxSize = BOX_XMAX - BOX_XMIN;
+
+  // Size cells from the median extent, so that a typical line's swept box
+  // covers one or two cells along each axis.
+  double median = boxSize;
+  if (n > 0) {
+    double* extents = malloc(sizeof(double) * n);
+    assert(extents != NULL);
+    for (unsigned int i = 0; i < n; i++) {
+      extents[i] = MAX(store->bottom_right[i].x - store->top_left[i].x,
+                       store->bottom_right[i].y - store->top_left[i].y);
+    }
+    qsort(extents, n, sizeof(double), compare_doubles);
+    median = extents[n / 2];
+    free(extents);
+  }
+
+  // Keep the number of cells within a small multiple of the number of lines,
+  // since every cell is visited each frame.
+  double dim = median > 0 ? floor(boxSize / (UNIFORMGRID_CELL_SCALE * median))
+                          : UNIFORMGRID_MAX_DIM;
+  dim = MIN(dim, ceil(2 * sqrt((double) n)));
+  dim = MIN(dim, UNIFORMGRID_MAX_DIM);
+  grid.dim = MAX(1, (unsigned int) dim);
+  grid.cellSize = boxSize / grid.dim;
+
+  grid.cellStart = malloc(sizeof(unsigned int) * (grid.dim * grid.dim + 1));
+  grid.cellLinesCapacity = MAX(1, 4 * n);
+  grid.cellLines = malloc(sizeof(unsigned int) * grid.cellLinesCapacity);
+  grid.lineRange = malloc(sizeof(GridRange) * MAX(1, n));
+  grid.numOfLines = n;
+  grid.numMallocs = n > 0 ? 4 : 3;  // the three arrays, and extents if n > 0
+  assert(grid.cellStart != NULL && grid.cellLines != NULL
+         && grid.lineRange != NULL);
+  return grid;
+}
+
+void UniformGrid_destroy(UniformGrid* grid) {
+  free(grid->cellStart);
+  free(grid->cellLines);
+  free(grid->lineRange);
+  grid->cellStart = NULL;
+  grid->cellLines = NULL;
+  grid->lineRange = NULL;
+}
+
+// Column or row of the cell containing coordinate v, where lo is the box's
+// lower bound along that axis.  Coordinates outside the box are clamped to
+// the edge cells, which keeps the mapping monotonic.
+static inline unsigned int cell_coordinate(const UniformGrid* grid, double v,
+                                           double lo) {
+  double c = (v - lo) / grid->cellSize;
+  if (!(c > 0)) {
+    return 0;
+  }
+  if (c >= grid->dim) {
+    return grid->dim - 1;
+  }
+  return (unsigned int) c;
+}
+
+void UniformGrid_update(UniformGrid* grid, const LineStore* store) {
+  assert(store->numOfLines == grid->numOfLines);
+  unsigned int dim = grid->dim;
+  unsigned int* cellStart = grid->cellStart;
+  memset(cellStart, 0, sizeof(unsigned int) * (dim * dim + 1));
+
+  // Count the lines in each cell, binning each by the same swept box that
+  // sweptBoxesOverlap() tests.
+  for (unsigned int l = 0; l < grid->numOfLines; l++) {
+    Vec tl = store->top_left[l];
+    Vec br = store->bottom_right[l];
+    Vec v = store->velocity[l];
+    double xlo = MIN(tl.x, tl.x + v.x);
+    double xhi = MAX(br.x, br.x + v.x);
+    double ylo = MIN(tl.y, tl.y + v.y);
+    double yhi = MAX(br.y, br.y + v.y);
+    // A line whose coordinates have become NaN overlaps nothing; leave it
+    // out of every cell.
+    GridRange r = { .x0 = 1, .y0 = 1, .x1 = 0, .y1 = 0 };
+    if (xlo <= xhi && ylo <= yhi) {
+      r = (GridRange) {
+        .x0 = cell_coordinate(grid, xlo, BOX_XMIN),
+        .y0 = cell_coordinate(grid, ylo, BOX_YMIN),
+        .x1 = cell_coordinate(grid, xhi, BOX_XMIN),
+        .y1 = cell_coordinate(grid, yhi, BOX_YMIN)
+      };
+    }
+    grid->lineRange[l] = r;
+    for (unsigned int y = r.y0; y <= r.y1; y++) {
+      for (unsigned int x = r.x0; x <= r.x1; x++) {
+        cellStart[y * dim + x]++;
+      }
+    }
+  }
+
+  // Turn the counts into the end of each cell's run of cellLines.
+  for (unsigned int c = 1; c < dim * dim; c++) {
+    cellStart[c] += cellStart[c - 1];
+  }
+  unsigned int total = cellStart[dim * dim - 1];
+  cellStart[dim * dim] = total;
+  if (total > grid->cellLinesCapacity) {
+    free(grid->cellLines);
+    grid->cellLinesCapacity = MAX(total, 2 * grid->cellLinesCapacity);
+    grid->cellLines = malloc(sizeof(unsigned int) * grid->cellLinesCapacity);
+    assert(grid->cellLines != NULL);
+    grid->numMallocs++;
+  }
+
+  // Fill each run from its end, visiting lines backwards so that every cell
+  // lists its lines in ID order.  Afterwards cellStart[c] is the start of c.
+  for (unsigned int l = grid->numOfLines; l-- > 0;) {
+    GridRange r = grid->lineRange[l];
+    for (unsigned int y = r.y0; y <= r.y1; y++) {
+      for (unsigned int x = r.x0; x <= r.x1; x++) {
+        grid->cellLines[--cellStart[y * dim + x]] = l;
+      }
+    }
+  }
+}
+
+// Tests l against candidates and appends the hits to list.
+static inline void test_candidates(IntersectionEventList* list,
+                                   const LineStore* store, unsigned int l,
+                                   const unsigned int* candidates,
+                                   unsigned int count) {
+  IntersectionType types[INTERSECT_BATCH_SIZE];
+  unsigned int hits = intersectBatch(store, l, candidates, count, types);
+  if (hits) {
+    IntersectionEventList_appendHits(list, l, candidates, hits, types);
+  }
+}
+
+typedef struct {
+  const UniformGrid* grid;
+  IntersectionEventList* events;
+  const LineStore* store;
+} DetectContext;
+
+// Tests the pairs of lines whose lowest shared cell is one of the cells from
+// begin up to end.  Returns the number of pairs tested.
+static unsigned long detect_in_cells(void* context, unsigned int begin,
+                                     unsigned int end) {
+  DetectContext* c = context;
+  const UniformGrid* grid = c->grid;
+  unsigned int dim = grid->dim;
+  unsigned long tested = 0;
+
+  for (unsigned int cell = begin; cell < end; cell++) {
+    unsigned int x = cell % dim;
+    unsigned int y = cell / dim;
+    unsigned int start = grid->cellStart[cell];
+    unsigned int stop = grid->cellStart[cell + 1];
+
+    for (unsigned int i = start; i < stop; i++) {
+      unsigned int l1 = grid->cellLines[i];
+      GridRange r1 = grid->lineRange[l1];
+      unsigned int candidates[INTERSECT_BATCH_SIZE];
+      unsigned int count = 0;
+
+      for (unsigned int j = i + 1; j < stop; j++) {
+        unsigned int l2 = grid->cellLines[j];
+        GridRange r2 = grid->lineRange[l2];
+        // Two lines share every cell in the intersection of their ranges;
+        // test them only in its lowest cell.
+        if (MAX(r1.x0, r2.x0) != x || MAX(r1.y0, r2.y0) != y) {
+          continue;
+        }
+        candidates[count++] = l2;
+        if (count == INTERSECT_BATCH_SIZE) {
+          test_candidates(c->events, c->store, l1, candidates, count);
+          tested += count;
+          count = 0;
+        }
+      }
+      if (count > 0) {
+        test_candidates(c->events, c->store, l1, candidates, count);
+        tested += count;
+      }
+    }
+  }
+  return tested;
+}
+
+unsigned long UniformGrid_detectCollisions(
+    const UniformGrid* grid, IntersectionEventList* events,
+    const LineStore* store) {
+  DetectContext context = { .grid = grid, .events = events, .store = store };
+  return Parallel_sum(grid->dim * grid->dim, UNIFORMGRID_CELL_GRAIN,
+                      detect_in_cells, &context);
+}
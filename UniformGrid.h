@@ -0,0 +1,83 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Uniform grid broad phase: every line is binned into each cell its swept
+// bounding box touches, and only lines sharing a cell are tested.
+#ifndef UNIFORMGRID_H_
+#define UNIFORMGRID_H_
+
+#include "./Line.h"
+#include "./IntersectionEventList.h"
+
+// Cells are this many times the median line extent on a side
+#define UNIFORMGRID_CELL_SCALE 2.0
+// Upper bound on the number of cells along each axis
+#define UNIFORMGRID_MAX_DIM 1024
+// Cells each worker takes at a time when testing pairs
+#define UNIFORMGRID_CELL_GRAIN 16
+
+// Range of cells, inclusive, covered by one line's swept bounding box
+typedef struct {
+  unsigned int x0;
+  unsigned int y0;
+  unsigned int x1;
+  unsigned int y1;
+} GridRange;
+
+struct UniformGrid {
+  // number of cells along each axis, and the width of one cell
+  unsigned int dim;
+  double cellSize;
+
+  // cellLines[cellStart[c] .. cellStart[c + 1]) are the IDs of the lines in
+  // cell c, where c = y * dim + x
+  unsigned int* cellStart;
+  unsigned int* cellLines;
+  unsigned int cellLinesCapacity;
+
+  // cells covered by each line this frame, indexed by line ID
+  GridRange* lineRange;
+  unsigned int numOfLines;
+
+  // calls to malloc made by the grid since it was made
+  unsigned long numMallocs;
+};
+typedef struct UniformGrid UniformGrid;
+
+// Makes a grid for the lines in store.  The cell size is chosen from the
+// distribution of line extents, which do not change as lines move.
+UniformGrid UniformGrid_make(const LineStore* store);
+
+void UniformGrid_destroy(UniformGrid* grid);
+
+// Rebins every line by its current swept bounding box.
+void UniformGrid_update(UniformGrid* grid, const LineStore* store);
+
+// Appends an event to events for every intersecting pair of lines that
+// share a cell.  A pair sharing several cells is tested only in the first of
+// them, so each pair is reported at most once.  Returns the number of pairs
+// tested.
+unsigned long UniformGrid_detectCollisions(
+    const UniformGrid* grid, IntersectionEventList* events,
+    const LineStore* store);
+
+#endif  // UNIFORMGRID_H_
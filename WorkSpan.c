@@ -0,0 +1,180 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "./WorkSpan.h"
+
+#ifdef WORK_SPAN
+
+#include <stdint.h>
+#include <stdio.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define WORKSPAN_UNIT "cycles"
+static inline uint64_t WorkSpan_now() {
+  return __rdtsc();
+}
+#else
+#include "./fasttime.h"
+#define WORKSPAN_UNIT "ns"
+static inline uint64_t WorkSpan_now() {
+  fasttime_t now = gettime();
+  return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+#endif
+
+// The work, span and burdened span of part of the computation
+typedef struct {
+  uint64_t work;
+  uint64_t span;
+  uint64_t burdened;
+} Cost;
+
+// Cost of the strand running now, up to WorkSpan_last: the serial code
+// since the innermost enclosing range began, with the loops it ran.
+static Cost WorkSpan_strand = { 0, 0, 0 };
+static uint64_t WorkSpan_last = 0;
+
+// The strand's cost when the current phase started
+static Cost WorkSpan_phaseStart;
+
+// Cost of each phase, summed over frames
+static Cost WorkSpan_phases[PHASE_NUM];
+static unsigned int WorkSpan_numFrames = 0;
+
+// Adds the time since WorkSpan_last to the strand, which runs it serially.
+static void WorkSpan_flush() {
+  uint64_t now = WorkSpan_now();
+  uint64_t elapsed = WorkSpan_last > 0 ? now - WorkSpan_last : 0;
+  WorkSpan_strand.work += elapsed;
+  WorkSpan_strand.span += elapsed;
+  WorkSpan_strand.burdened += elapsed;
+  WorkSpan_last = now;
+}
+
+static uint64_t max(uint64_t a, uint64_t b) {
+  return a > b ? a : b;
+}
+
+// Runs iterations [begin, end) as the pthreads runtime would: while the
+// range is larger than the grain, its upper half is pushed, where another
+// worker may steal it, and its lower half kept.  Returns the range's cost.
+static Cost WorkSpan_range(unsigned int begin, unsigned int end,
+                           unsigned int grain, ParallelForBody body,
+                           void* context) {
+  if (end - begin <= grain) {
+    Cost outer = WorkSpan_strand;
+    WorkSpan_strand = (Cost) { 0, 0, 0 };
+    WorkSpan_last = WorkSpan_now();
+    body(context, begin, end);
+    WorkSpan_flush();
+    Cost cost = WorkSpan_strand;
+    WorkSpan_strand = outer;
+    return cost;
+  }
+  unsigned int mid = begin + (end - begin) / 2;
+  Cost lower = WorkSpan_range(begin, mid, grain, body, context);
+  Cost upper = WorkSpan_range(mid, end, grain, body, context);
+  return (Cost) {
+    .work = lower.work + upper.work,
+    .span = max(lower.span, upper.span),
+    .burdened = max(lower.burdened, upper.burdened + WORKSPAN_STEAL_BURDEN),
+  };
+}
+
+void WorkSpan_for(unsigned int n, unsigned int grain, ParallelForBody body,
+                  void* context) {
+  if (n == 0) {
+    return;
+  }
+  if (grain == 0) {
+    grain = 1;
+  }
+  WorkSpan_flush();
+  Cost loop = WorkSpan_range(0, n, grain, body, context);
+  WorkSpan_strand.work += loop.work;
+  WorkSpan_strand.span += loop.span;
+  WorkSpan_strand.burdened += loop.burdened;
+  // Leave out the time spent here splitting ranges.
+  WorkSpan_last = WorkSpan_now();
+}
+
+void WorkSpan_start() {
+  WorkSpan_flush();
+  WorkSpan_phaseStart = WorkSpan_strand;
+}
+
+void WorkSpan_stop(Phase phase) {
+  WorkSpan_flush();
+  Cost* total = &WorkSpan_phases[phase];
+  total->work += WorkSpan_strand.work - WorkSpan_phaseStart.work;
+  total->span += WorkSpan_strand.span - WorkSpan_phaseStart.span;
+  total->burdened += WorkSpan_strand.burdened - WorkSpan_phaseStart.burdened;
+}
+
+void WorkSpan_endFrame() {
+  WorkSpan_numFrames++;
+}
+
+static void WorkSpan_printRow(const char* name, Cost cost, double scale) {
+  printf("%-10s %12.0f %12.0f %8.2f %12.0f %8.2f\n", name,
+         scale * cost.work, scale * cost.span,
+         cost.span > 0 ? (double) cost.work / cost.span : 0,
+         scale * cost.burdened,
+         cost.burdened > 0 ? (double) cost.work / cost.burdened : 0);
+}
+
+void WorkSpan_print() {
+  if (WorkSpan_numFrames == 0) {
+    return;
+  }
+  double scale = 1.0 / WorkSpan_numFrames;
+  printf("---- WORK/SPAN (%u frames, means per frame in %s) ----\n",
+         WorkSpan_numFrames, WORKSPAN_UNIT);
+  printf("%-10s %12s %12s %8s %12s %8s\n", "phase", "work", "span",
+         "par.", "burdened", "b. par.");
+  // The phases run one after another, so their spans add up.
+  Cost frame = { 0, 0, 0 };
+  for (int p = 0; p < PHASE_NUM; p++) {
+    WorkSpan_printRow(PhaseTimer_names[p], WorkSpan_phases[p], scale);
+    frame.work += WorkSpan_phases[p].work;
+    frame.span += WorkSpan_phases[p].span;
+    frame.burdened += WorkSpan_phases[p].burdened;
+  }
+  WorkSpan_printRow("frame", frame, scale);
+
+  // The work and span laws bound the speedup from above; by Brent's bound
+  // a greedy scheduler that pays the burden on every steal takes at most
+  // (T1 - Tinf) / P + the burdened span.
+  printf("%-10s %12s %12s\n", "workers", "upper bound", "burdened");
+  for (unsigned int p = 1; p <= WORKSPAN_MAX_WORKERS; p *= 2) {
+    double work = frame.work;
+    double upper = frame.span > 0 && work / frame.span < p
+        ? work / frame.span : p;
+    double burdened = work > 0
+        ? work / ((work - frame.span) / p + frame.burdened) : 0;
+    printf("%-10u %12.2f %12.2f\n", p, upper, burdened);
+  }
+  printf("---- END WORK/SPAN ----\n");
+}
+
+#endif  // WORK_SPAN
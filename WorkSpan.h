@@ -0,0 +1,68 @@
+/**
+ * Copyright (c) 2015 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Work/span analysis, in the manner of Cilkview.  Built with -DWORK_SPAN
+// ("make WORKSPAN=1", which also turns on the phase timers), every
+// Parallel_for() runs serially on the calling thread through the same
+// halving of ranges that the pthreads runtime does, and the time of each
+// range is measured.  From these the work (total time) and span (longest
+// path through the spawn tree) of each phase are added up, along with a
+// burdened span that charges every steal on the path, and Screensaver
+// prints the parallelism of each phase and the speedup to expect on 1 up
+// to WORKSPAN_MAX_WORKERS workers.  Times are in TSC cycles where there is
+// a TSC, and nanoseconds elsewhere.
+#ifndef WORKSPAN_H_
+#define WORKSPAN_H_
+
+#include "./Parallel.h"
+#include "./PhaseTimer.h"
+
+// Cilkview's estimate of what a steal costs, in instructions, taken as
+// cycles here
+#define WORKSPAN_STEAL_BURDEN 15000
+
+// Largest worker count the speedup estimate is printed for
+#define WORKSPAN_MAX_WORKERS 64
+
+#ifdef WORK_SPAN
+
+// Runs body over the iterations from 0 up to n, in ranges of at most grain
+// iterations, measuring the loop's work and span.  Called by Parallel_for().
+void WorkSpan_for(unsigned int n, unsigned int grain, ParallelForBody body,
+                  void* context);
+
+// Marks the start of a phase.  Called by PhaseTimer_start().
+void WorkSpan_start();
+
+// Adds the work and span since WorkSpan_start() to phase.  Called by
+// PhaseTimer_stop().
+void WorkSpan_stop(Phase phase);
+
+void WorkSpan_endFrame();
+
+// Prints each phase's per-frame work, span and parallelism, and the
+// speedup bounds for powers of two up to WORKSPAN_MAX_WORKERS workers.
+void WorkSpan_print();
+
+#endif  // WORK_SPAN
+
+#endif  // WORKSPAN_H_
@@ -0,0 +1,249 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2015 the Massachusetts Institute of Technology
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""Benchmarks Screensaver over a fixed set of scenes.
+
+Runs every scene in betainputs/, plus a few large scenes made by SceneGen,
+several times each.  Records the median and minimum time, frames per second
+and collision counts as JSON and CSV, and compares them with a stored
+baseline: a scene whose median time grew by more than the threshold (and by
+more than a small absolute amount, to ignore noise on tiny scenes), whose
+collision counts changed, that failed to run although the baseline ran it,
+or that is missing from the results, is flagged and makes the exit status
+1.  A scene that fails in the baseline too, such as a file that never
+loads, is reported but not flagged.
+
+Typical use:
+  make bench-baseline   # record bench_baseline.json on a known-good tree
+  make bench            # compare the current tree against it
+"""
+
+import argparse
+import csv
+import glob
+import json
+import os
+import re
+import statistics
+import subprocess
+import sys
+
+# Large generated scenes: name, SceneGen options.  The seeds are fixed so
+# that the scenes, and so the collision counts, never change.
+GENERATED_SCENES = [
+  ('gen-uniform-20k',
+   '-s 1 -n 20000 -l uniform:2:8 -v uniform:0:40'),
+  ('gen-clustered-20k',
+   '-s 2 -n 20000 -l uniform:2:8 -v uniform:0:40 -c 16:60'),
+  ('gen-static-50k',
+   '-s 3 -n 50000 -l uniform:1:4 -v uniform:0:40 -a 0.5 -z 0.9'),
+]
+
+RESULT_FIELDS = ['scene', 'lines', 'frames', 'repeats', 'median_s', 'min_s',
+                 'frames_per_s', 'wall_collisions', 'line_collisions',
+                 'error']
+
+
+def generate_scenes(scene_gen, directory):
+  """Makes the generated scenes that are not already in directory."""
+  os.makedirs(directory, exist_ok=True)
+  paths = []
+  for name, options in GENERATED_SCENES:
+    path = os.path.join(directory, name + '.bin')
+    if not os.path.exists(path):
+      subprocess.run([scene_gen, '-b'] + options.split() + [path],
+                     check=True, stdout=subprocess.DEVNULL)
+    paths.append(path)
+  return paths
+
+
+def count_lines(path):
+  """Returns the number of lines in a scene, text or binary."""
+  with open(path, 'rb') as f:
+    head = f.read(24)
+  if head.startswith(b'LINESCN\0'):
+    return int.from_bytes(head[16:20], sys.byteorder)
+  return int(head.split()[0])
+
+
+def find(pattern, out):
+  """Returns the first group of pattern in out."""
+  match = re.search(pattern, out)
+  if match is None:
+    raise ValueError('no match for "%s" in the output' % pattern)
+  return match.group(1)
+
+
+def run_once(args, path, frames):
+  """Runs one simulation and returns (seconds, wall, line collisions)."""
+  command = [args.screensaver] + args.args.split() + [str(frames), path]
+  out = subprocess.run(command, check=True, capture_output=True,
+                       text=True).stdout
+  seconds = float(find(r'Elapsed execution time: ([0-9.]+)s', out))
+  wall = int(find(r'(\d+) Line-Wall Collisions', out))
+  line = int(find(r'(\d+) Line-Line Collisions', out))
+  return seconds, wall, line
+
+
+def bench_scene(args, path, frames):
+  times = []
+  counts = set()
+  for _ in range(args.repeats):
+    seconds, wall, line = run_once(args, path, frames)
+    times.append(seconds)
+    counts.add((wall, line))
+  if len(counts) != 1:
+    print('warning: %s gave different counts across runs: %s'
+          % (path, sorted(counts)), file=sys.stderr)
+  wall, line = min(counts)
+  median = statistics.median(times)
+  return {
+    'scene': os.path.relpath(path),
+    'lines': count_lines(path),
+    'frames': frames,
+    'repeats': args.repeats,
+    'median_s': median,
+    'min_s': min(times),
+    'frames_per_s': frames / median if median > 0 else 0.0,
+    'wall_collisions': wall,
+    'line_collisions': line,
+  }
+
+
+def compare(results, baseline, threshold, min_delta):
+  """Returns a list of problems found comparing results with baseline."""
+  problems = []
+  if baseline['args'] != results['args']:
+    problems.append('baseline was run with arguments "%s", not "%s"'
+                    % (baseline['args'], results['args']))
+  new = {(r['scene'], r['frames']): r for r in results['results']}
+  for b in baseline['results']:
+    if (b['scene'], b['frames']) not in new:
+      problems.append('%s: in the baseline but missing from the results'
+                      % b['scene'])
+  old = {(r['scene'], r['frames']): r for r in baseline['results']}
+  for r in results['results']:
+    b = old.get((r['scene'], r['frames']))
+    if b is None or 'error' in b:
+      continue
+    if 'error' in r:
+      problems.append('%s: failed: %s' % (r['scene'], r['error']))
+      continue
+    if (r['wall_collisions'], r['line_collisions']) \
+        != (b['wall_collisions'], b['line_collisions']):
+      problems.append('%s: collisions changed from %d wall, %d line to '
+                      '%d wall, %d line'
+                      % (r['scene'], b['wall_collisions'],
+                         b['line_collisions'], r['wall_collisions'],
+                         r['line_collisions']))
+    if r['median_s'] > b['median_s'] * (1 + threshold) \
+        and r['median_s'] - b['median_s'] > min_delta:
+      problems.append('%s: median %.4fs is %.0f%% slower than %.4fs'
+                      % (r['scene'], r['median_s'],
+                         100 * (r['median_s'] / b['median_s'] - 1),
+                         b['median_s']))
+  return problems
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__,
+      formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('--screensaver', default='./Screensaver')
+  parser.add_argument('--scene-gen', default='./SceneGen')
+  parser.add_argument('--frames', type=int, default=400,
+                      help='frames for each scene in betainputs/')
+  parser.add_argument('--large-frames', type=int, default=20,
+                      help='frames for each generated scene')
+  parser.add_argument('--repeats', type=int, default=3)
+  parser.add_argument('--args', default='',
+                      help='extra Screensaver options, e.g. "-b grid -w 4"')
+  parser.add_argument('--scenes', default='betainputs/*.in',
+                      help='glob of the small scenes')
+  parser.add_argument('--no-generated', action='store_true',
+                      help='skip the generated scenes')
+  parser.add_argument('--scene-dir', default='bench_scenes',
+                      help='where generated scenes are kept')
+  parser.add_argument('--json', default='bench.json')
+  parser.add_argument('--csv', default='bench.csv')
+  parser.add_argument('--baseline', default='bench_baseline.json')
+  parser.add_argument('--save-baseline', action='store_true',
+                      help='store the results as the baseline')
+  parser.add_argument('--threshold', type=float, default=0.10,
+                      help='slowdown that is flagged (default 0.10 = 10%%)')
+  parser.add_argument('--min-delta', type=float, default=0.005,
+                      help='slowdowns of fewer seconds than this are noise')
+  args = parser.parse_args()
+
+  scenes = [(path, args.frames) for path in sorted(glob.glob(args.scenes))]
+  if not args.no_generated:
+    scenes += [(path, args.large_frames)
+               for path in generate_scenes(args.scene_gen, args.scene_dir)]
+
+  results = {'args': args.args, 'results': []}
+  print('%-44s %8s %6s %10s %10s %10s %8s %10s'
+        % ('scene', 'lines', 'frames', 'median s', 'min s', 'frames/s',
+           'wall', 'line'))
+  for path, frames in scenes:
+    try:
+      r = bench_scene(args, path, frames)
+    except (subprocess.CalledProcessError, ValueError, OSError) as e:
+      # keep the failure in the results, so that it is compared, and
+      # stored, like any other outcome
+      print('%s: failed: %s' % (path, e), file=sys.stderr)
+      results['results'].append({'scene': os.path.relpath(path),
+                                 'frames': frames, 'repeats': args.repeats,
+                                 'error': str(e)})
+      continue
+    results['results'].append(r)
+    print('%-44s %8d %6d %10.4f %10.4f %10.1f %8d %10d'
+          % (r['scene'], r['lines'], r['frames'], r['median_s'], r['min_s'],
+             r['frames_per_s'], r['wall_collisions'], r['line_collisions']))
+
+  with open(args.json, 'w') as f:
+    json.dump(results, f, indent=2)
+  with open(args.csv, 'w', newline='') as f:
+    writer = csv.DictWriter(f, fieldnames=RESULT_FIELDS, restval='')
+    writer.writeheader()
+    writer.writerows(results['results'])
+  print('Wrote %s and %s' % (args.json, args.csv))
+
+  if args.save_baseline:
+    with open(args.baseline, 'w') as f:
+      json.dump(results, f, indent=2)
+    print('Saved baseline %s' % args.baseline)
+    return 0
+  if not os.path.exists(args.baseline):
+    print('No baseline %s to compare with; make one with --save-baseline'
+          % args.baseline)
+    return 0
+  with open(args.baseline) as f:
+    problems = compare(results, json.load(f), args.threshold,
+                       args.min_delta)
+  for problem in problems:
+    print('REGRESSION: ' + problem)
+  if not problems:
+    print('No regressions against %s' % args.baseline)
+  return 1 if problems else 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())